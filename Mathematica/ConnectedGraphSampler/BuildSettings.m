@@ -14,7 +14,7 @@ Switch[$OperatingSystem,
 
   "Unix", (* Compilation settings for Linux *)
   $buildSettings = {
-    "CompileOptions" -> {"-std=c++14", "-O3"}
+    "CompileOptions" -> {"-std=c++14", "-O3", "-pthread"}
 
     (*
     , "IncludeDirectories" -> {}
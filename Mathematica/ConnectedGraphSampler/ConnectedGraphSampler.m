@@ -38,17 +38,25 @@ CGSSample::usage =
     "CGSSample[degrees, Exponent -> \[Alpha]] sets the degree affinity exponent.";
 
 CGSSampleProp::usage =
-    "CGSSampleProp[degrees, prop, n] generates n random graphs with the given degrees, computes prop[graph] for each, then returns the obtained weighted samples as a WeightedData. Accepts the same options as CGSSample.";
+    "CGSSampleProp[degrees, prop, n] generates n random graphs with the given degrees, computes prop[graph] for each, then returns the obtained weighted samples as a WeightedData. Accepts the same options as CGSSample.\n" <>
+    "CGSSampleProp[degrees, prop, n, \"TargetRelativeError\" -> e] stops early, once the relative standard error of the weighted mean of prop is at most e. n may be Infinity. The options \"TargetESS\" and \"TimeBudget\" work as in CGSSampleWeights.";
 
-CGSSampleWeights::usage = "CGSSampleWeights[degrees, n] generates n random graphs with the given degrees and returns the logarithms of their sampling weights. Accepts the same options as CGSSample.";
+CGSSampleWeights::usage =
+    "CGSSampleWeights[degrees, n] generates n random graphs with the given degrees and returns the logarithms of their sampling weights. Accepts the same options as CGSSample.\n" <>
+    "CGSSampleWeights[degrees, n, \"TargetESS\" -> ess] stops early, once the effective sample size is at least ess. n may be Infinity.\n" <>
+    "CGSSampleWeights[degrees, n, \"TimeBudget\" -> t] stops after t seconds, or after the time given as a Quantity.";
 
-CGSSamplePropRaw::usage = "CGSSamplePropRaw[degrees, prop, n] generates n random graphs with the given degrees, computes value = prop[graph] for each, and returns the result as {value, Log[samplingWeight]} pairs. Accepts the same options as CGSSample.";
+CGSSamplePropRaw::usage = "CGSSamplePropRaw[degrees, prop, n] generates n random graphs with the given degrees, computes value = prop[graph] for each, and returns the result as {value, Log[samplingWeight]} pairs. Accepts the same options as CGSSampleProp.";
 
 CGSToWeightedData::usage = "CGSToWeightedData[rawData] converts a list of {value, Log[samplingWeight]} pairs to a WeightedData expression.";
 
-CGSGraphicalQ::usage = "CGSGraphicalQ[degrees] tests if degrees are realized by a simple graph.";
+CGSGraphicalQ::usage = "CGSGraphicalQ[degrees] tests if degrees are realized by a simple graph.\n" <>
+    "CGSGraphicalQ[{degrees1, degrees2, ...}] tests many degree sequences at once.";
 
-CGSPotentiallyConnectedQ::usage = "CGSPotentiallyConnectedQ[degrees] tests if degrees are potentially connected.";
+CGSPotentiallyConnectedQ::usage = "CGSPotentiallyConnectedQ[degrees] tests if degrees are potentially connected.\n" <>
+    "CGSPotentiallyConnectedQ[{degrees1, degrees2, ...}] tests many degree sequences at once.";
+
+CGSClassifyDegreeSequences::usage = "CGSClassifyDegreeSequences[{degrees1, degrees2, ...}] returns {graphicalQ, multigraphicalQ, potentiallyConnectedQ} for each degree sequence. The sequences are classified in parallel.";
 
 
 `Developer`Recompile::usage = "ConnectedGraphSampler`Developer`Recompile[] recompiles the ConnectedGraphSampler library and reloads the functions.";
@@ -95,7 +103,8 @@ template =
             LFun["generateConnSample", {Real (* alpha *)}, {Integer, 2}],
             LFun["getEdges", {}, {Integer, 2}],
             LFun["getLogProb", {}, Real],
-            LFun["graphicalQ", {}, True | False]
+            LFun["graphicalQ", {}, True | False],
+            LFun["classifySequences", {{Integer, 1, "Constant"} (* concatenated degrees *), {Integer, 1, "Constant"} (* offsets *)}, {Integer, 1}]
           }
         ],
         LClass["ConnectedGraphSamplerMulti",
@@ -194,21 +203,93 @@ check[val_] := val
 toGraph[n_, opt : OptionsPattern[]][edges_] := Graph[Range[n], edges + 1, Sequence@@FilterRules[{opt}, Options[Graph]]]
 
 
+ConnectedGraphSampler::target = "The value of the option `1` must be None or a positive number.";
+ConnectedGraphSampler::nostop = "An infinite sample count requires the \"TargetESS\", \"TargetRelativeError\" or \"TimeBudget\" option.";
+ConnectedGraphSampler::nonnum = "The property value `1` is not a real number. \"TargetRelativeError\" requires a numerical property.";
+
+target::usage = "target[name, value] validates the value of a stopping option, and converts time Quantities to seconds.";
+target[name_, None] := None
+target[name_, q_Quantity] := target[name, QuantityMagnitude@UnitConvert[q, "Seconds"]]
+target[name_, val_ ? Positive] := N[val]
+target[name_, val_] := (Message[ConnectedGraphSampler::target, name]; throw[$Failed])
+
+minRelErrSamples::usage = "The relative error is not trusted below this many samples.";
+minRelErrSamples = 10;
+
+sampleUntil::usage =
+    "sampleUntil[gen, n, {ess, relerr, budget}] evaluates gen[] at most n times, and returns the list of results. " <>
+    "gen[] must return {value, logprob}. Sampling stops early once all targets out of ess and relerr that are not None are met, " <>
+    "or once budget seconds have passed. The weight sums are kept relative to the largest log-weight, as in the C++ WeightStats.";
+sampleUntil[gen_, n_, {ess_, relerr_, budget_}] :=
+    Module[{bag = Internal`Bag[], k = 0, start = AbsoluteTime[], done = False,
+            x, logprob, logw, r, w, mean, shift = -Infinity, s1 = 0., s2 = 0., s1x = 0., s2x = 0., s2xx = 0.},
+      If[n === Infinity && {ess, relerr, budget} === {None, None, None},
+        Message[ConnectedGraphSampler::nostop];
+        throw[$Failed]
+      ];
+      While[k < n && Not[done],
+        {x, logprob} = gen[];
+        Internal`StuffBag[bag, {x, logprob}];
+        k++;
+
+        logw = -logprob;
+        If[logw > shift,
+          r = If[shift === -Infinity, 0., Exp[shift - logw]];
+          s1 *= r; s1x *= r;
+          s2 *= r^2; s2x *= r^2; s2xx *= r^2;
+          shift = logw
+        ];
+        w = Exp[logw - shift];
+        s1 += w;
+        s2 += w^2;
+        If[relerr =!= None,
+          If[Not@TrueQ@Internal`RealValuedNumericQ[x],
+            Message[ConnectedGraphSampler::nonnum, x];
+            throw[$Failed]
+          ];
+          s1x += w x; s2x += w^2 x; s2xx += w^2 x^2
+        ];
+
+        done =
+          (ess =!= None || relerr =!= None) &&
+          (ess === None || s1^2/s2 >= ess) &&
+          (relerr === None || k >= minRelErrSamples && (mean = s1x/s1; Sqrt@Max[s2xx - 2 mean s2x + mean^2 s2, 0]/s1 <= relerr Abs[mean])) ||
+          (budget =!= None && AbsoluteTime[] - start >= budget)
+      ];
+      Internal`BagPart[bag, All]
+    ]
+
+
 (***** Definitions of package functions *****)
 
-CGSGraphicalQ[degrees : {___Integer}] :=
-    catch@Block[{sampler = Make["ConnectedGraphSampler"]},
-      If[Max[degrees] >= Length[degrees],
-        False,
-        sampler@"setDS"[degrees];
-        sampler@"graphicalQ"[]
-      ]
+(* Flags returned by classifySequences, see SequenceClass in Graphicality.h *)
+$graphicalFlag = 1;
+$multigraphicalFlag = 2;
+$potentiallyConnectedFlag = 4;
+
+classify::usage = "classify[{degrees1, degrees2, ...}] returns the SequenceClass flags of each degree sequence.";
+classify[seqs : {{___Integer}...}] :=
+    Block[{sampler = Make["ConnectedGraphSampler"], values = Developer`ToPackedArray@Flatten[seqs]},
+      (* an empty list cannot be passed as an integer tensor; it is not accessed when all sequences are empty *)
+      If[values === {}, values = {0}];
+      check@sampler@"classifySequences"[values, Prepend[Accumulate[Length /@ seqs], 0]]
+    ]
+
+CGSClassifyDegreeSequences[seqs : {{___Integer}...}] :=
+    catch@Transpose@Map[
+      Thread[BitAnd[classify[seqs], #] > 0]&,
+      {$graphicalFlag, $multigraphicalFlag, $potentiallyConnectedFlag}
     ]
 
 
-CGSPotentiallyConnectedQ[{0}] := True (* special case of a single isolated vertex *)
-CGSPotentiallyConnectedQ[degrees : {___Integer ? Positive}] :=
-    Total[degrees]/2 >= Length[degrees] - 1 && FreeQ[degrees, 0, {1}]
+CGSGraphicalQ[degrees : {___Integer}] := catch@First@CGSGraphicalQ[{degrees}]
+CGSGraphicalQ[seqs : {{___Integer}..}] := catch@Thread[BitAnd[classify[seqs], $graphicalFlag] > 0]
+
+
+(* The degree sum is even, no vertex is isolated unless there is only one, and there are at least n-1 edges.
+   The null graph is not considered potentially connected, as with CGSSample. *)
+CGSPotentiallyConnectedQ[degrees : {___Integer}] := catch@First@CGSPotentiallyConnectedQ[{degrees}]
+CGSPotentiallyConnectedQ[seqs : {{___Integer}..}] := catch@Thread[BitAnd[classify[seqs], $potentiallyConnectedFlag] > 0]
 CGSPotentiallyConnectedQ[_] := False
 
 
@@ -246,25 +327,25 @@ Options[CGSSampleWeights] = {
   "MultiEdges" -> False,
   "Connected" -> False,
   RandomSeeding -> Automatic,
-  Exponent -> 1
+  Exponent -> 1,
+  "TargetESS" -> None,
+  "TimeBudget" -> None
 };
-CGSSampleWeights[degrees_, n_Integer ? NonNegative, opt : OptionsPattern[]] :=
+CGSSampleWeights[degrees_, n : (_Integer ? NonNegative | Infinity), opt : OptionsPattern[]] :=
     catch@Block[{sampler = If[TrueQ@OptionValue["MultiEdges"], Make["ConnectedGraphSamplerMulti"], Make["ConnectedGraphSampler"]]},
       check@sampler@"setDS"[degrees];
       sampler@"seed"[ Replace[OptionValue[RandomSeeding], Automatic :> RandomInteger[2^31-1]] ];
       If[TrueQ@OptionValue["Connected"],
-        Table[
-          check@sampler@"generateConnSample"[OptionValue[Exponent]];
-          sampler@"getLogProb"[],
-          {n}
+        sampleUntil[
+          Function[check@sampler@"generateConnSample"[OptionValue[Exponent]]; {0, sampler@"getLogProb"[]}],
+          n, {target["TargetESS", OptionValue["TargetESS"]], None, target["TimeBudget", OptionValue["TimeBudget"]]}
         ]
         ,
-        Table[
-          check@sampler@"generateSample"[OptionValue[Exponent]];
-          sampler@"getLogProb"[],
-          {n}
+        sampleUntil[
+          Function[check@sampler@"generateSample"[OptionValue[Exponent]]; {0, sampler@"getLogProb"[]}],
+          n, {target["TargetESS", OptionValue["TargetESS"]], None, target["TimeBudget", OptionValue["TimeBudget"]]}
         ]
-      ]
+      ][[All, 2]]
     ]
 
 
@@ -272,33 +353,31 @@ Options[CGSSampleProp] = {
   "MultiEdges" -> False,
   "Connected" -> False,
   RandomSeeding -> Automatic,
-  Exponent -> 1
+  Exponent -> 1,
+  "TargetESS" -> None,
+  "TargetRelativeError" -> None,
+  "TimeBudget" -> None
 };
 SyntaxInformation[CGSSampleProp] = {"ArgumentsPattern" -> {_, _, _, OptionsPattern[]}};
-CGSSampleProp[degrees_, prop_, n_Integer ? NonNegative, opt : OptionsPattern[]] :=
+CGSSampleProp[degrees_, prop_, n : (_Integer ? NonNegative | Infinity), opt : OptionsPattern[]] :=
     CGSToWeightedData@CGSSamplePropRaw[degrees, prop, n, opt]
 
 
-Options[CGSSamplePropRaw] = {
-  "MultiEdges" -> False,
-  "Connected" -> False,
-  RandomSeeding -> Automatic,
-  Exponent -> 1
-};
+Options[CGSSamplePropRaw] = Options[CGSSampleProp];
 SyntaxInformation[CGSSamplePropRaw] = {"ArgumentsPattern" -> {_, _, _, OptionsPattern[]}};
-CGSSamplePropRaw[degrees_, prop_, n_Integer ? NonNegative, opt : OptionsPattern[]] :=
+CGSSamplePropRaw[degrees_, prop_, n : (_Integer ? NonNegative | Infinity), opt : OptionsPattern[]] :=
     catch@Block[{sampler = If[TrueQ@OptionValue["MultiEdges"], Make["ConnectedGraphSamplerMulti"], Make["ConnectedGraphSampler"]]},
       check@sampler@"setDS"[degrees];
       sampler@"seed"[ Replace[OptionValue[RandomSeeding], Automatic :> RandomInteger[2^31-1]] ];
       If[TrueQ@OptionValue["Connected"],
-        Table[
-          {prop@toGraph[Length[degrees]]@check@sampler@"generateConnSample"[OptionValue[Exponent]], sampler@"getLogProb"[]},
-          {n}
+        sampleUntil[
+          Function[{prop@toGraph[Length[degrees]]@check@sampler@"generateConnSample"[OptionValue[Exponent]], sampler@"getLogProb"[]}],
+          n, {target["TargetESS", OptionValue["TargetESS"]], target["TargetRelativeError", OptionValue["TargetRelativeError"]], target["TimeBudget", OptionValue["TimeBudget"]]}
         ]
         ,
-        Table[
-          {prop@toGraph[Length[degrees]]@check@sampler@"generateSample"[OptionValue[Exponent]], sampler@"getLogProb"[]},
-          {n}
+        sampleUntil[
+          Function[{prop@toGraph[Length[degrees]]@check@sampler@"generateSample"[OptionValue[Exponent]], sampler@"getLogProb"[]}],
+          n, {target["TargetESS", OptionValue["TargetESS"]], target["TargetRelativeError", OptionValue["TargetRelativeError"]], target["TimeBudget", OptionValue["TimeBudget"]]}
         ]
       ]
     ]
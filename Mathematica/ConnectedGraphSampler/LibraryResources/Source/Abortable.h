@@ -0,0 +1,26 @@
+
+#ifndef CONNECTED_GRAPH_SAMPLER_ABORTABLE
+#define CONNECTED_GRAPH_SAMPLER_ABORTABLE
+
+#include <LTemplate.h>
+
+#include "../../../../src/SampleControl.h"
+#include "../../../../src/EdgeSink.h"
+
+#include <tuple>
+
+// Generate a sample with fun(sink, control), where 'control' polls for a pending Abort[].
+// If there is one, the sample is abandoned and a LibraryFunctionError is returned to the kernel, which then aborts.
+template<typename Fun>
+std::tuple<CDS::edgelist_t, double> abortable_sample(Fun fun) {
+    CDS::EdgeListSink sink;
+    auto control = CDS::make_sample_control([] (const CDS::Progress &) { return mma::check_abort(); });
+    try {
+        fun(sink, control);
+    } catch (const CDS::SamplingCancelled &) {
+        throw mma::LibraryError();
+    }
+    return sink.result();
+}
+
+#endif // CONNECTED_GRAPH_SAMPLER_ABORTABLE
@@ -8,6 +8,8 @@
 
 #include "../../../../src/Sampler.h"
 #include "../../../../src/ConnSampler.h"
+#include "../../../../src/Graphicality.h"
+#include "Abortable.h"
 
 #include <random>
 
@@ -43,15 +45,34 @@ public:
     }
 
     mma::IntTensorRef getDS() const {
-        return mma::makeVector<mint>(ds->degrees().size(), ds->degrees().data());
+        auto degrees = ds->degrees();
+        return mma::makeVector<mint>(degrees.size(), degrees.data());
     }
 
     mma::IntTensorRef getDistrib() const {
-        return mma::makeVector<mint>(ds->degree_distribution().size(), ds->degree_distribution().data());
+        auto distrib = ds->degree_distribution();
+        return mma::makeVector<mint>(distrib.size(), distrib.data());
     }
 
     bool graphicalQ() const { return ds->is_graphical(); }
 
+    // Classify many degree sequences in parallel, see Graphicality.h. Sequence i is
+    // values[offsets[i]] .. values[offsets[i+1] - 1]. Does not use the stored degree sequence.
+    mma::IntTensorRef classifySequences(mma::IntTensorRef values, mma::IntTensorRef offsets) const {
+        if (offsets.length() == 0)
+            throw mma::LibraryError("classifySequences: invalid offsets.");
+        const mint count = offsets.length() - 1;
+        for (mint i=0; i < count; ++i)
+            if (offsets[i] < 0 || offsets[i] > offsets[i+1] || offsets[i+1] > values.length())
+                throw mma::LibraryError("classifySequences: invalid offsets.");
+
+        std::vector<unsigned char> classes(count);
+        ThreadPool pool;
+        classify_sequences(values.data(), offsets.data(), count, classes.data(), pool);
+
+        return mma::makeVector<mint>(count, classes.data());
+    }
+
     /*
     void decrement(int u) { ds->decrement(u); }
     void increment(int u) { ds->increment(u); }
@@ -74,12 +95,16 @@ public:
     }
 
     mma::IntMatrixRef generateSample(double alpha) {
-        std::tie(edges, logprob) = CDS::sample(*ds, alpha, rng);
+        std::tie(edges, logprob) = abortable_sample([&] (EdgeListSink &sink, auto &control) {
+            CDS::sample(*ds, alpha, rng, sink, control);
+        });
         return getEdges();
     }
 
     mma::IntMatrixRef generateConnSample(double alpha) {
-        std::tie(edges, logprob) = CDS::sample_conn(*ds, alpha, rng);
+        std::tie(edges, logprob) = abortable_sample([&] (EdgeListSink &sink, auto &control) {
+            CDS::sample_conn(*ds, alpha, rng, sink, control);
+        });
         return getEdges();
     }
 };
@@ -8,6 +8,7 @@
 
 #include "../../../../src/SamplerMulti.h"
 #include "../../../../src/ConnSamplerMulti.h"
+#include "Abortable.h"
 
 #include <random>
 
@@ -58,12 +59,16 @@ public:
     }
 
     mma::IntMatrixRef generateSample(double alpha) {
-        std::tie(edges, logprob) = CDS::sample_multi(*ds, alpha, rng);
+        std::tie(edges, logprob) = abortable_sample([&] (EdgeListSink &sink, auto &control) {
+            CDS::sample_multi(*ds, alpha, rng, sink, control);
+        });
         return getEdges();
     }
 
     mma::IntMatrixRef generateConnSample(double alpha) {
-        std::tie(edges, logprob) = CDS::sample_conn_multi(*ds, alpha, rng);
+        std::tie(edges, logprob) = abortable_sample([&] (EdgeListSink &sink, auto &control) {
+            CDS::sample_conn_multi(*ds, alpha, rng, sink, control);
+        });
         return getEdges();
     }
 };
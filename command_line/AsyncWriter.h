@@ -0,0 +1,211 @@
+#ifndef CDS_ASYNC_WRITER_H
+#define CDS_ASYNC_WRITER_H
+
+#include "VertexOrder.h"
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstddef>
+#include <algorithm>
+
+// Writes samples in the text output format on a separate thread, so that sampling and output overlap.
+//
+// The sampler thread fills preallocated sample buffers taken from a bounded single-producer,
+// single-consumer ring, and the writer thread formats and writes them. When all buffers are in use,
+// the sampler waits for the writer, thus memory use stays bounded even when output is the bottleneck.
+// The ring itself is lock-free. A thread which finds it empty (the writer) or full (the sampler) yields a few times,
+// then parks on a condition variable instead of spinning on. The other thread only takes the mutex to wake it if it is parked,
+// and only once half of the ring is ready for it, so that small samples do not cost a wakeup each.
+// Formatted output is collected and written in large blocks of 'block_size' bytes.
+class AsyncTextWriter {
+public:
+
+    // A single sample: edges are stored as consecutive vertex pairs.
+    struct Sample {
+        std::vector<int> edges;
+        double logprob;
+    };
+
+    // Fills a Sample buffer. This is the sink passed to the sampler.
+    class Sink {
+        Sample &sample;
+
+    public:
+
+        explicit Sink(Sample &sample) : sample(sample) { sample.edges.clear(); }
+
+        void edge(int u, int v) {
+            sample.edges.push_back(u);
+            sample.edges.push_back(v);
+        }
+
+        void finish(double logprob) { sample.logprob = logprob; }
+    };
+
+private:
+
+    static const std::size_t block_size = std::size_t(1) << 20;
+    static const int spin_limit = 64; // the number of times to yield before parking
+
+    std::FILE *out;
+    const CDS::Relabelling &relabelling;
+
+    std::vector<Sample> ring;
+    std::atomic<std::size_t> head; // number of samples published by the sampler thread
+    std::atomic<std::size_t> tail; // number of samples consumed by the writer thread
+    std::atomic<bool> done;
+    std::atomic<bool> error;
+
+    // Parking for an empty or full ring. The flags and the ring indices use sequentially consistent operations:
+    // either the parking thread sees the other thread's update when it checks again, or the other thread sees its flag.
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+    std::atomic<bool> writer_parked, sampler_parked;
+    const std::size_t batch; // the number of samples or free buffers to wait for when parked
+
+    std::string buffer;
+    std::thread writer;
+
+    void append_int(int x) {
+        char digits[12];
+        int len = 0;
+        do {
+            digits[len++] = '0' + x % 10;
+            x /= 10;
+        } while (x > 0);
+        while (len > 0)
+            buffer += digits[--len];
+    }
+
+    // Write all complete blocks, or everything if 'all' is true.
+    void write_buffer(bool all) {
+        std::size_t len = all ? buffer.size() : buffer.size() / block_size * block_size;
+        if (len == 0)
+            return;
+        if (std::fwrite(buffer.data(), 1, len, out) != len)
+            error = true;
+        buffer.erase(0, len);
+    }
+
+    void format(const Sample &sample) {
+        char num[32];
+        std::snprintf(num, sizeof(num), "%.17g\n", sample.logprob);
+        buffer += num;
+        for (std::size_t i=0; i < sample.edges.size(); i += 2) {
+            // Samplers use 0-based indexing. Increment vertex names to output with 1-based indexing.
+            append_int(relabelling.original(sample.edges[i]) + 1);
+            buffer += '\t';
+            append_int(relabelling.original(sample.edges[i+1]) + 1);
+            buffer += '\n';
+        }
+        buffer += '\n';
+
+        if (buffer.size() >= block_size)
+            write_buffer(false);
+    }
+
+    // Wake the thread waiting on 'cv' if its flag is set and 'ready' items are enough for it
+    void wake(std::atomic<bool> &parked, std::condition_variable &cv, std::size_t ready) {
+        if (parked.load() && ready >= batch) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_one();
+        }
+    }
+
+    void run() {
+        int spins = 0;
+        while (true) {
+            std::size_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load()) {
+                if (done.load() && t == head.load())
+                    break;
+
+                if (++spins <= spin_limit) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                spins = 0;
+
+                std::unique_lock<std::mutex> lock(mutex);
+                writer_parked.store(true);
+                not_empty.wait(lock, [&] { return head.load() - t >= batch || done.load(); });
+                writer_parked.store(false);
+                continue;
+            }
+
+            spins = 0;
+            format(ring[t % ring.size()]);
+
+            tail.store(t+1);
+            wake(sampler_parked, not_full, ring.size() - (head.load() - (t+1)));
+        }
+
+        write_buffer(true);
+        std::fflush(out);
+    }
+
+public:
+
+    // 'edge_count' is the number of edges in each sample, used to preallocate the buffers.
+    AsyncTextWriter(std::FILE *out, const CDS::Relabelling &relabelling, std::size_t edge_count, std::size_t buffer_count = 16) :
+        out(out), relabelling(relabelling),
+        ring(buffer_count),
+        head(0), tail(0), done(false), error(false),
+        writer_parked(false), sampler_parked(false),
+        batch(std::max<std::size_t>(1, buffer_count/2))
+    {
+        for (auto &sample : ring)
+            sample.edges.reserve(2*edge_count);
+        buffer.reserve(2*block_size);
+
+        writer = std::thread(&AsyncTextWriter::run, this);
+    }
+
+    AsyncTextWriter(const AsyncTextWriter &) = delete;
+    AsyncTextWriter & operator = (const AsyncTextWriter &) = delete;
+
+    // Writes all published samples, then stops the writer thread.
+    ~AsyncTextWriter() { close(); }
+
+    void close() {
+        if (writer.joinable()) {
+            done.store(true);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                not_empty.notify_one();
+            }
+            writer.join();
+        }
+    }
+
+    // Get the next free sample buffer. Waits while all buffers are in use.
+    Sample &acquire() {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        for (int spins = 0; h - tail.load() == ring.size() && spins < spin_limit; ++spins)
+            std::this_thread::yield();
+        if (h - tail.load() == ring.size()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            sampler_parked.store(true);
+            not_full.wait(lock, [&] { return ring.size() - (h - tail.load()) >= batch; });
+            sampler_parked.store(false);
+        }
+        return ring[h % ring.size()];
+    }
+
+    // Pass the buffer obtained from the last acquire() to the writer thread.
+    void publish() {
+        const std::size_t h = head.load(std::memory_order_relaxed) + 1;
+        head.store(h);
+        wake(writer_parked, not_empty, h - tail.load());
+    }
+
+    // True if writing failed
+    bool failed() const { return error; }
+};
+
+#endif // CDS_ASYNC_WRITER_H
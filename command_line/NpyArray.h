@@ -0,0 +1,243 @@
+#ifndef CDS_NPY_ARRAY_H
+#define CDS_NPY_ARRAY_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Memory-mapped array stored in the NumPy .npy format (version 1.0).
+// The file is preallocated on construction, so an upper bound on the shape must be known up front.
+// If fewer elements are written, the array can be shrunk to its final shape with shrink().
+// The data can be read without any parsing using numpy.load(filename, mmap_mode='r').
+template<typename T>
+class NpyArray {
+
+    int fd;
+    size_t header_size;
+    size_t file_size;
+    size_t mapped_size;
+    char *base;
+    size_t count; // total number of elements
+
+    static bool little_endian() {
+        const uint16_t x = 1;
+        return *reinterpret_cast<const char *>(&x) == 1;
+    }
+
+    // Construct the header of the .npy file, padded to a multiple of 64 bytes, and at least to 'min_size' bytes.
+    static std::string make_header(const std::vector<size_t> &shape, size_t min_size = 0) {
+        std::string dict = "{'descr': '";
+        dict += full_descr();
+        dict += "', 'fortran_order': False, 'shape': (";
+        for (size_t i=0; i < shape.size(); ++i) {
+            if (i > 0)
+                dict += ", ";
+            dict += std::to_string(shape[i]);
+        }
+        if (shape.size() == 1)
+            dict += ','; // 1-tuples need a trailing comma in Python
+        dict += "), }";
+
+        const size_t prefix = 10; // magic string, version and header length
+        size_t total = prefix + dict.size() + 1;
+        total = std::max((total + 63) / 64 * 64, min_size);
+        dict.append(total - prefix - dict.size() - 1, ' ');
+        dict += '\n';
+
+        if (dict.size() > 0xffff)
+            throw std::length_error("NpyArray: Header too long.");
+
+        std::string header = "\x93NUMPY";
+        header += '\x01';
+        header += '\x00';
+        header += char(dict.size() & 0xff);
+        header += char(dict.size() >> 8);
+        header += dict;
+
+        return header;
+    }
+
+public:
+
+    // NumPy type string of T, without the byte order character
+    static const char *descr();
+
+    // The value of the 'descr' field that the header must have
+    static std::string full_descr() { return (little_endian() ? "<" : ">") + std::string(descr()); }
+
+    NpyArray(const std::string &filename, const std::vector<size_t> &shape) :
+        fd(-1), base(nullptr)
+    {
+        count = 1;
+        for (const auto &s : shape)
+            count *= s;
+
+        std::string header = make_header(shape);
+        header_size = header.size();
+        file_size = mapped_size = header_size + count*sizeof(T);
+
+        fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1)
+            throw std::runtime_error("Could not open " + filename + " for writing.");
+
+        if (ftruncate(fd, file_size) != 0) {
+            close(fd);
+            throw std::runtime_error("Could not allocate " + filename + ".");
+        }
+
+        void *p = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not memory-map " + filename + ".");
+        }
+        base = static_cast<char *>(p);
+
+        std::memcpy(base, header.data(), header_size);
+    }
+
+    NpyArray(const NpyArray &) = delete;
+    NpyArray & operator = (const NpyArray &) = delete;
+
+    ~NpyArray() {
+        munmap(base, mapped_size);
+        if (file_size < mapped_size)
+            (void) ftruncate(fd, file_size);
+        close(fd);
+    }
+
+    T *data() { return reinterpret_cast<T *>(base + header_size); }
+
+    T & operator [] (size_t i) { return data()[i]; }
+
+    size_t size() const { return count; }
+
+    // Reduce the array to the given shape, which must not have more elements than the current one.
+    // The data is kept in place, so only trailing elements of the row-major layout are dropped.
+    // The file is truncated when the array is destroyed.
+    void shrink(const std::vector<size_t> &shape) {
+        size_t new_count = 1;
+        for (const auto &s : shape)
+            new_count *= s;
+        if (new_count > count)
+            throw std::invalid_argument("NpyArray: Cannot grow the array.");
+
+        // The header can only get shorter, so pad it to its original size to keep the data in place.
+        std::string header = make_header(shape, header_size);
+        if (header.size() != header_size)
+            throw std::length_error("NpyArray: Header size changed.");
+        std::memcpy(base, header.data(), header_size);
+
+        count = new_count;
+        file_size = header_size + count*sizeof(T);
+    }
+};
+
+// Read-only memory-mapped .npy file, as written by NpyArray<T>.
+// Only C-order arrays with the native byte order of type T are accepted.
+template<typename T>
+class NpyReader {
+
+    int fd;
+    size_t file_size;
+    const char *base;
+    size_t header_size;
+    std::vector<size_t> dims;
+
+    // Value of 'key' in the header dictionary, up to the closing character 'end'
+    static std::string field(const std::string &dict, const std::string &key, char end) {
+        size_t pos = dict.find("'" + key + "': ");
+        if (pos == std::string::npos)
+            throw std::runtime_error("NpyReader: Missing field " + key + ".");
+        pos += key.size() + 4;
+        size_t stop = dict.find(end, pos + 1);
+        if (stop == std::string::npos)
+            throw std::runtime_error("NpyReader: Invalid field " + key + ".");
+        return dict.substr(pos, stop - pos + 1);
+    }
+
+public:
+
+    explicit NpyReader(const std::string &filename) : fd(-1), base(nullptr) {
+        fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw std::runtime_error("Could not open " + filename + ".");
+
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size < 10) {
+            close(fd);
+            throw std::runtime_error(filename + " is not a NumPy file.");
+        }
+        file_size = size;
+
+        void *p = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not memory-map " + filename + ".");
+        }
+        base = static_cast<const char *>(p);
+
+        try {
+            if (std::memcmp(base, "\x93NUMPY\x01\x00", 8) != 0)
+                throw std::runtime_error(filename + " is not a version 1.0 NumPy file.");
+            size_t dict_size = uint8_t(base[8]) | (size_t(uint8_t(base[9])) << 8);
+            header_size = 10 + dict_size;
+            if (header_size > file_size)
+                throw std::runtime_error(filename + ": Truncated header.");
+            const std::string dict(base + 10, dict_size);
+
+            if (field(dict, "descr", '\'') != "'" + NpyArray<T>::full_descr() + "'")
+                throw std::runtime_error(filename + ": Unexpected element type.");
+            if (field(dict, "fortran_order", ',') != "False,")
+                throw std::runtime_error(filename + ": Fortran order is not supported.");
+
+            const std::string shape = field(dict, "shape", ')');
+            size_t count = 1;
+            for (size_t pos = 1; pos < shape.size(); ) {
+                size_t len;
+                size_t d = std::stoul(shape.substr(pos), &len);
+                dims.push_back(d);
+                count *= d;
+                pos = shape.find_first_of(",)", pos + len) + 1;
+                while (pos < shape.size() && (shape[pos] == ' ' || shape[pos] == ')'))
+                    pos++;
+            }
+            if (header_size + count*sizeof(T) > file_size)
+                throw std::runtime_error(filename + ": Truncated data.");
+        } catch (const std::logic_error &) {
+            munmap(const_cast<char *>(base), file_size);
+            close(fd);
+            throw std::runtime_error(filename + ": Invalid header.");
+        } catch (...) {
+            munmap(const_cast<char *>(base), file_size);
+            close(fd);
+            throw;
+        }
+    }
+
+    NpyReader(const NpyReader &) = delete;
+    NpyReader & operator = (const NpyReader &) = delete;
+
+    ~NpyReader() {
+        munmap(const_cast<char *>(base), file_size);
+        close(fd);
+    }
+
+    const std::vector<size_t> &shape() const { return dims; }
+
+    const T *data() const { return reinterpret_cast<const T *>(base + header_size); }
+
+    const T & operator [] (size_t i) const { return data()[i]; }
+};
+
+template<> inline const char *NpyArray<int32_t>::descr() { return "i4"; }
+template<> inline const char *NpyArray<int64_t>::descr() { return "i8"; }
+template<> inline const char *NpyArray<double>::descr()  { return "f8"; }
+
+#endif // CDS_NPY_ARRAY_H
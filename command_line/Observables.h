@@ -0,0 +1,161 @@
+#ifndef CDS_OBSERVABLES_H
+#define CDS_OBSERVABLES_H
+
+#include "Common.h"
+#include "StoppingRule.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+
+// Graph statistics which can be estimated with cdsample --stat, and the summary reported on the standard error.
+
+
+// Degree assortativity: the Pearson correlation of the degrees at the two ends of an edge.
+inline double degree_assortativity(const CDS::edgelist_t &edges, const std::vector<CDS::deg_t> &degrees) {
+    double sum_prod = 0, sum_mean = 0, sum_sqr = 0;
+    for (const auto &e : edges) {
+        double j = degrees[e.first], k = degrees[e.second];
+        sum_prod += j*k;
+        sum_mean += (j + k) / 2;
+        sum_sqr  += (j*j + k*k) / 2;
+    }
+    const double m = edges.size();
+    const double mean = sum_mean / m;
+    return (sum_prod / m - mean*mean) / (sum_sqr / m - mean*mean);
+}
+
+// Number of triangles on 'n' vertices. Multi-edges are counted once.
+inline long triangle_count(int n, const CDS::edgelist_t &edges) {
+    std::vector<std::vector<int>> adj(n);
+    for (const auto &e : edges) {
+        adj[e.first].push_back(e.second);
+        adj[e.second].push_back(e.first);
+    }
+    for (auto &list : adj) {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+
+    // Count each triangle u < v < w once, from its smallest vertex
+    long count = 0;
+    CDS::ExclusionSet marked(n);
+    for (int u=0; u < n; ++u) {
+        marked.clear();
+        for (int v : adj[u])
+            marked.insert(v);
+        for (int v : adj[u])
+            if (v > u)
+                for (int w : adj[v])
+                    if (w > v && marked[w])
+                        count++;
+    }
+    return count;
+}
+
+
+// Statistics which can be tracked with --stat
+enum class Statistic { Assortativity, Triangles };
+
+inline Statistic parse_statistic(const std::string &name) {
+    if (name == "assortativity")
+        return Statistic::Assortativity;
+    if (name == "triangles")
+        return Statistic::Triangles;
+    throw std::invalid_argument("Unknown statistic '" + name + "'.");
+}
+
+inline std::string statistic_name(Statistic s) {
+    switch (s) {
+    case Statistic::Assortativity: return "assortativity";
+    case Statistic::Triangles:     return "triangles";
+    }
+    return "";
+}
+
+
+// Computes the requested statistics on each sample, and records them in the stopping rule
+// together with the logprob. Edges are only collected when there are statistics to compute.
+// The statistics do not depend on the vertex labels, as long as 'degrees' uses the same labels as the edges.
+class Observer {
+    const std::vector<CDS::deg_t> &degrees;
+    const std::vector<Statistic> &stats;
+    CDS::StoppingRule &rule;
+
+    CDS::edgelist_t edges;
+    std::vector<double> values;
+
+public:
+
+    Observer(const std::vector<CDS::deg_t> &degrees, const std::vector<Statistic> &stats, CDS::StoppingRule &rule) :
+        degrees(degrees), stats(stats), rule(rule)
+    { }
+
+    void edge(int u, int v) {
+        if (! stats.empty())
+            edges.push_back({u, v});
+    }
+
+    void finish(double logprob) {
+        values.clear();
+        for (const auto &s : stats) {
+            switch (s) {
+            case Statistic::Assortativity:
+                values.push_back(degree_assortativity(edges, degrees));
+                break;
+            case Statistic::Triangles:
+                values.push_back(triangle_count(degrees.size(), edges));
+                break;
+            }
+        }
+        rule.add(logprob, values);
+        edges.clear();
+    }
+};
+
+// Passes a sample both to the output sink and to the observer.
+template<typename Sink>
+class ObservingSink {
+    Sink sink;
+    Observer &observer;
+
+public:
+
+    ObservingSink(Sink sink, Observer &observer) : sink(std::move(sink)), observer(observer) { }
+
+    void edge(int u, int v) {
+        sink.edge(u, v);
+        observer.edge(u, v);
+    }
+
+    void finish(double logprob) {
+        sink.finish(logprob);
+        observer.finish(logprob);
+    }
+};
+
+template<typename Sink>
+ObservingSink<Sink> make_observing_sink(Sink sink, Observer &observer) {
+    return ObservingSink<Sink>(std::move(sink), observer);
+}
+
+
+// Print the sample count, the ESS, log(sum w), and the weighted mean and standard error of each statistic.
+// Full precision is used, so that summaries of equivalent runs can be compared exactly.
+inline void print_summary(std::ostream &out, long count, const CDS::StoppingRule &rule, const std::vector<Statistic> &stats) {
+    const auto precision = out.precision(17);
+    out << "Samples: " << count << '\n'
+        << "ESS: " << rule.weight_stats().ess() << '\n'
+        << "log(sum w): " << rule.weight_stats().log_weight_sum() << '\n';
+    if (! stats.empty()) {
+        out << "statistic\tmean\tstderr\n";
+        for (std::size_t k=0; k < stats.size(); ++k)
+            out << statistic_name(stats[k]) << '\t' << rule.observables()[k].mean() << '\t' << rule.observables()[k].standard_error() << '\n';
+    }
+    out.precision(precision);
+}
+
+#endif // CDS_OBSERVABLES_H
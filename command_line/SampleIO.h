@@ -0,0 +1,247 @@
+#ifndef CDS_SAMPLE_IO_H
+#define CDS_SAMPLE_IO_H
+
+#include "Common.h"
+#include "VertexOrder.h"
+#include "NpyArray.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+// Reading and writing the output files of cdsample.
+
+
+// Writes a sample directly into the memory-mapped NumPy arrays. Keeps the 0-based indexing of the samplers.
+class NpySink {
+    int32_t *edge_out;
+    double *logprob_out;
+    const CDS::Relabelling &relabelling;
+
+public:
+
+    NpySink(int32_t *edge_out, double *logprob_out, const CDS::Relabelling &relabelling) :
+        edge_out(edge_out), logprob_out(logprob_out), relabelling(relabelling)
+    { }
+
+    void edge(int u, int v) {
+        *edge_out++ = relabelling.original(u);
+        *edge_out++ = relabelling.original(v);
+    }
+
+    void finish(double logprob) { *logprob_out = logprob; }
+};
+
+
+// Describes a sharded cdsample run, and which shard a file contains. Shard 'index' out of 'shards'
+// contains the samples with global index i = index, index + shards, ... below 'count'.
+// Sample i is generated from the random stream CounterRNG(seed, i), thus the output does not depend on the number of shards.
+//
+// It is written as a single line, which is the first line of text output, or the file PREFIX_shard.txt for NumPy output:
+//   # cdsample shard=K/N seed=S count=C vertices=V alpha=A connected=0 multi=0 order=O stats=S1,S2
+// Merging all shards of a run gives the same output as running it with shard=0/1.
+struct ShardInfo {
+    long index = 0, shards = 1;
+    uint64_t seed = 0;
+    long count = 0;
+    int vertices = 0;
+    double alpha = 1;
+    bool connected = false, multi = false;
+    std::string order = "input";
+    std::vector<std::string> stats;
+
+    // Number of samples in this shard
+    long shard_count() const { return index < count ? (count - index + shards - 1) / shards : 0; }
+
+    // Do the two describe shards of the same run?
+    bool same_run(const ShardInfo &other) const {
+        return shards == other.shards && seed == other.seed && count == other.count && vertices == other.vertices &&
+               alpha == other.alpha && connected == other.connected && multi == other.multi &&
+               order == other.order && stats == other.stats;
+    }
+
+    std::string to_string() const {
+        char alpha_str[32];
+        std::snprintf(alpha_str, sizeof(alpha_str), "%.17g", alpha);
+
+        std::string stat_list;
+        for (const auto &s : stats)
+            stat_list += (stat_list.empty() ? "" : ",") + s;
+
+        std::ostringstream line;
+        line << "# cdsample shard=" << index << '/' << shards << " seed=" << seed << " count=" << count
+             << " vertices=" << vertices << " alpha=" << alpha_str
+             << " connected=" << connected << " multi=" << multi << " order=" << order << " stats=" << stat_list;
+        return line.str();
+    }
+
+    static ShardInfo parse(const std::string &line) {
+        std::istringstream in(line);
+        std::string hash, name;
+        in >> hash >> name;
+        if (hash != "#" || name != "cdsample")
+            throw std::runtime_error("Missing cdsample shard header.");
+
+        ShardInfo info;
+        std::string field;
+        while (in >> field) {
+            auto eq = field.find('=');
+            if (eq == std::string::npos)
+                throw std::runtime_error("Invalid shard header field '" + field + "'.");
+            const std::string key = field.substr(0, eq), value = field.substr(eq+1);
+
+            try {
+                if (key == "shard")
+                    parse_shard(value, info.index, info.shards);
+                else if (key == "seed")
+                    info.seed = std::stoull(value);
+                else if (key == "count")
+                    info.count = std::stol(value);
+                else if (key == "vertices")
+                    info.vertices = std::stoi(value);
+                else if (key == "alpha")
+                    info.alpha = std::stod(value);
+                else if (key == "connected")
+                    info.connected = std::stoi(value);
+                else if (key == "multi")
+                    info.multi = std::stoi(value);
+                else if (key == "order")
+                    info.order = value;
+                else if (key == "stats") {
+                    std::istringstream list(value);
+                    std::string s;
+                    while (std::getline(list, s, ','))
+                        info.stats.push_back(s);
+                }
+                else
+                    throw std::runtime_error("Unknown shard header field '" + key + "'.");
+            } catch (const std::logic_error &) {
+                throw std::runtime_error("Invalid shard header field '" + field + "'.");
+            }
+        }
+        return info;
+    }
+
+    // Parse "K/N"
+    static void parse_shard(const std::string &text, long &index, long &shards) {
+        auto slash = text.find('/');
+        if (slash == std::string::npos)
+            throw std::invalid_argument("Invalid shard '" + text + "', use the form K/N.");
+        size_t len1, len2;
+        index = std::stol(text.substr(0, slash), &len1);
+        shards = std::stol(text.substr(slash+1), &len2);
+        if (len1 != slash || len2 != text.size() - slash - 1 || shards < 1 || index < 0 || index >= shards)
+            throw std::invalid_argument("Invalid shard '" + text + "', K must be between 0 and N-1.");
+    }
+};
+
+
+// Reads the samples of one shard in order. Vertices are returned with 0-based indexing.
+class SampleReader {
+public:
+    virtual ~SampleReader() { }
+
+    virtual const ShardInfo &info() const = 0;
+
+    // Read the next sample. Returns false at the end of the input.
+    virtual bool next(CDS::edgelist_t &edges, double &logprob) = 0;
+};
+
+// Reads the text output of cdsample --shard
+class TextSampleReader : public SampleReader {
+    std::string filename;
+    std::ifstream in;
+    ShardInfo shard_info;
+
+public:
+
+    explicit TextSampleReader(const std::string &filename) : filename(filename), in(filename) {
+        if (! in)
+            throw std::runtime_error("Could not open " + filename + ".");
+        std::string line;
+        std::getline(in, line);
+        shard_info = ShardInfo::parse(line);
+    }
+
+    const ShardInfo &info() const { return shard_info; }
+
+    bool next(CDS::edgelist_t &edges, double &logprob) {
+        std::string line;
+        if (! std::getline(in, line))
+            return false;
+
+        char *end;
+        logprob = std::strtod(line.c_str(), &end);
+        if (end == line.c_str())
+            throw std::runtime_error(filename + ": Expected a logprob, found '" + line + "'.");
+
+        edges.clear();
+        while (std::getline(in, line) && ! line.empty()) {
+            int u, v;
+            if (std::sscanf(line.c_str(), "%d\t%d", &u, &v) != 2)
+                throw std::runtime_error(filename + ": Expected an edge, found '" + line + "'.");
+            edges.push_back({u-1, v-1});
+        }
+        return true;
+    }
+};
+
+// Reads the NumPy output of cdsample --npy PREFIX --shard
+class NpySampleReader : public SampleReader {
+    ShardInfo shard_info;
+    NpyReader<int32_t> edge_data;
+    NpyReader<int64_t> offsets;
+    NpyReader<double> logprobs;
+    long pos;
+
+    static ShardInfo read_info(const std::string &prefix) {
+        std::ifstream in(prefix + "_shard.txt");
+        std::string line;
+        if (! std::getline(in, line))
+            throw std::runtime_error("Could not read " + prefix + "_shard.txt.");
+        return ShardInfo::parse(line);
+    }
+
+public:
+
+    explicit NpySampleReader(const std::string &prefix) :
+        shard_info(read_info(prefix)),
+        edge_data(prefix + "_edges.npy"),
+        offsets(prefix + "_offsets.npy"),
+        logprobs(prefix + "_logprob.npy"),
+        pos(0)
+    {
+        const size_t count = logprobs.shape().at(0);
+        if (offsets.shape().at(0) != count + 1 || size_t(offsets[count]) > edge_data.shape().at(0))
+            throw std::runtime_error(prefix + ": Inconsistent NumPy arrays.");
+    }
+
+    const ShardInfo &info() const { return shard_info; }
+
+    bool next(CDS::edgelist_t &edges, double &logprob) {
+        if (size_t(pos) == logprobs.shape()[0])
+            return false;
+        edges.clear();
+        for (int64_t i = offsets[pos]; i < offsets[pos+1]; ++i)
+            edges.push_back({edge_data[2*i], edge_data[2*i+1]});
+        logprob = logprobs[pos];
+        pos++;
+        return true;
+    }
+};
+
+// Open the output of a cdsample shard: either a text file, or the prefix of NumPy files.
+inline std::unique_ptr<SampleReader> open_samples(const std::string &name) {
+    if (std::ifstream(name + "_shard.txt"))
+        return std::unique_ptr<SampleReader>(new NpySampleReader(name));
+    else
+        return std::unique_ptr<SampleReader>(new TextSampleReader(name));
+}
+
+#endif // CDS_SAMPLE_IO_H
@@ -0,0 +1,775 @@
+#ifndef CDS_SAMPLE_SERVER_H
+#define CDS_SAMPLE_SERVER_H
+
+#include "Common.h"
+#include "PrefixCache.h"
+#include "CounterRNG.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+#include <csignal>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// The sampling server of cdsample --serve.
+//
+// Clients connect to a Unix domain socket and send requests, each of which is answered by a stream of messages.
+// Every message, in both directions, is a frame: a 32-bit payload length followed by the payload, whose first
+// byte is the message type. All integers are little-endian, and floating point numbers are IEEE 754 doubles.
+//
+// Requests:
+//   'S' sample:  u8 flags (1: connected, 2: multigraphs, 4: by sequence ID), f64 alpha, i64 count, u64 seed,
+//                then either u64 sequence ID, or u32 n followed by n u32 degrees; count is at most max_count
+//   'T' stats:   no body
+//
+// Responses:
+//   'G' graph:   f64 logprob, u32 m, then 2m u32 vertices, with 0-based indexing
+//   'E' end:     u64 sequence ID, i64 count; sent after the last graph of a sample request
+//   'X' error:   message text; the request was not carried out, and the connection stays usable
+//   'T' stats:   u64 requests, u64 samples, u32 cached sequences, u64 cache hits, u64 cache misses,
+//                u32 latency count, f64 latency p50, p90, p99, max in seconds, over the most recent requests
+//
+// Sample i of a request is generated from the random stream CounterRNG(seed, i), thus the samples are
+// identical to those of cdsample --seed SEED --shard 0/1. With a prefix cache depth, they are still determined
+// by the seed, but differ from those. The sequence ID is a hash of the degree sequence.
+// Once a sequence has been sent, later requests may refer to it by ID as long as it is in the cache.
+//
+// The server keeps the validated and set up sampler state for recently used sequences, for each mode and alpha,
+// and copies it for each sample. The thread running the server waits for requests on all connections at once,
+// and hands each request to one of a fixed set of worker threads, thus idle connections do not occupy a worker.
+// The requests of a single connection are processed one at a time, in order. When the server is stopped,
+// all connections are closed, and a sample request in progress ends after the current sample.
+
+
+// Protocol constants
+namespace ServerProtocol {
+    const uint8_t sample_request = 'S', stats_request = 'T';
+    const uint8_t graph_message = 'G', end_message = 'E', error_message = 'X', stats_message = 'T';
+
+    const uint8_t flag_connected = 1, flag_multi = 2, flag_by_id = 4;
+
+    const uint32_t max_frame = uint32_t(1) << 30;
+    const int64_t max_count = int64_t(1) << 24;
+}
+
+
+// Thrown when the connection fails or the client sends malformed data. The connection is closed.
+class ConnectionError : public std::runtime_error {
+public:
+    explicit ConnectionError(const std::string &what) : std::runtime_error(what) { }
+};
+
+
+// Reads the fields of a request payload in order
+class PayloadReader {
+    const std::string &data;
+    std::size_t pos;
+
+    const char *take(std::size_t n) {
+        if (data.size() - pos < n)
+            throw ConnectionError("Truncated request.");
+        const char *p = data.data() + pos;
+        pos += n;
+        return p;
+    }
+
+    uint64_t read_le(int bytes) {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(take(bytes));
+        uint64_t x = 0;
+        for (int i = bytes-1; i >= 0; --i)
+            x = (x << 8) | p[i];
+        return x;
+    }
+
+public:
+
+    explicit PayloadReader(const std::string &data) : data(data), pos(0) { }
+
+    uint8_t  u8()  { return uint8_t(read_le(1)); }
+    uint32_t u32() { return uint32_t(read_le(4)); }
+    uint64_t u64() { return read_le(8); }
+    int64_t  i64() { return int64_t(read_le(8)); }
+
+    double f64() {
+        uint64_t bits = u64();
+        double x;
+        std::memcpy(&x, &bits, sizeof x);
+        return x;
+    }
+
+    std::size_t remaining() const { return data.size() - pos; }
+};
+
+// Builds a payload
+class PayloadWriter {
+    std::string data;
+
+    void write_le(uint64_t x, int bytes) {
+        for (int i=0; i < bytes; ++i, x >>= 8)
+            data.push_back(char(x & 0xff));
+    }
+
+public:
+
+    explicit PayloadWriter(uint8_t type) { data.push_back(char(type)); }
+
+    PayloadWriter &u8(uint8_t x)   { write_le(x, 1); return *this; }
+    PayloadWriter &u32(uint32_t x) { write_le(x, 4); return *this; }
+    PayloadWriter &u64(uint64_t x) { write_le(x, 8); return *this; }
+    PayloadWriter &i64(int64_t x)  { write_le(uint64_t(x), 8); return *this; }
+
+    PayloadWriter &f64(double x) {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof bits);
+        return u64(bits);
+    }
+
+    PayloadWriter &text(const std::string &s) { data += s; return *this; }
+
+    const std::string &payload() const { return data; }
+};
+
+
+// Buffered framing over a connected socket. Reading never blocks, so that one thread can wait for
+// the requests of all connections; writing does.
+class Connection {
+    int fd;
+    std::string in;      // received, not yet consumed bytes
+    std::size_t in_pos;
+    std::string out;     // frames not yet sent
+
+    static const std::size_t flush_size = std::size_t(1) << 16;
+
+public:
+
+    explicit Connection(int fd) : fd(fd), in_pos(0) { }
+
+    // Read the data that has arrived, without blocking. Returns false at end of stream.
+    bool receive() {
+        if (in_pos > 0) {
+            in.erase(0, in_pos);
+            in_pos = 0;
+        }
+        char buf[1 << 16];
+        ssize_t r;
+        do {
+            r = ::recv(fd, buf, sizeof buf, MSG_DONTWAIT);
+        } while (r < 0 && errno == EINTR);
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (r < 0)
+            throw ConnectionError(std::string("Read failed: ") + std::strerror(errno));
+        in.append(buf, r);
+        return r > 0;
+    }
+
+    // Take the next frame from the received data. Returns false if it has not arrived completely yet.
+    bool next_frame(std::string &payload) {
+        if (in.size() - in_pos < 4)
+            return false;
+
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(in.data() + in_pos);
+        uint32_t length = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+        if (length == 0 || length > ServerProtocol::max_frame)
+            throw ConnectionError("Invalid frame length.");
+        if (in.size() - in_pos < 4 + std::size_t(length))
+            return false;
+
+        payload.assign(in, in_pos + 4, length);
+        in_pos += 4 + std::size_t(length);
+        return true;
+    }
+
+    // True if part of a frame has been received
+    bool partial() const { return in.size() > in_pos; }
+
+    void send(const std::string &payload) {
+        const uint32_t length = payload.size();
+        for (int i=0; i < 4; ++i)
+            out.push_back(char((length >> (8*i)) & 0xff));
+        out += payload;
+        if (out.size() >= flush_size)
+            flush();
+    }
+
+    void flush() {
+        std::size_t done = 0;
+        while (done < out.size()) {
+            ssize_t w = ::write(fd, out.data() + done, out.size() - done);
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0)
+                throw ConnectionError(std::string("Write failed: ") + std::strerror(errno));
+            done += w;
+        }
+        out.clear();
+    }
+};
+
+
+// Collects the edges of a sample, then sends them as a graph message
+class GraphMessageSink {
+    Connection &connection;
+    std::vector<uint32_t> vertices;
+
+public:
+
+    explicit GraphMessageSink(Connection &connection) : connection(connection) { }
+
+    void edge(int u, int v) {
+        vertices.push_back(u);
+        vertices.push_back(v);
+    }
+
+    void finish(double logprob) {
+        PayloadWriter message(ServerProtocol::graph_message);
+        message.f64(logprob).u32(vertices.size() / 2);
+        for (const auto &v : vertices)
+            message.u32(v);
+        connection.send(message.payload());
+        vertices.clear();
+    }
+};
+
+
+// Sampler state for a given sequence, mode and alpha, set up once and copied for each sample.
+class PreparedSampler {
+public:
+    virtual ~PreparedSampler() { }
+    virtual void sample(CDS::CounterRNG &rng, GraphMessageSink &sink) const = 0;
+};
+
+// A PrefixCache keeping the prepared initial state, and caching the choices of the first 'depth' edges.
+// With no cached levels, its samples are identical to those of the plain samplers on the same random stream.
+template<typename Connectivity, typename Graphs, typename Weight>
+class PreparedSamplerImpl : public PreparedSampler {
+    // Many samplers may be kept, thus each stores a smaller part of the decision tree than cdsample does
+    static const std::size_t capacity = std::size_t(1) << 20;
+
+    CDS::PrefixCache<Connectivity, Graphs, Weight> cache;
+
+public:
+
+    PreparedSamplerImpl(Graphs graphs, const Weight &weight, int depth) : cache(std::move(graphs), weight, depth, capacity) { }
+
+    void sample(CDS::CounterRNG &rng, GraphMessageSink &sink) const { cache.sample(rng, sink); }
+};
+
+// Throws std::invalid_argument if the sequence cannot be sampled in the given mode
+template<typename Connectivity, typename Graphs>
+std::shared_ptr<const PreparedSampler> prepare_sampler(Graphs graphs, double alpha, int depth) {
+    if (alpha == 1)
+        return std::make_shared<PreparedSamplerImpl<Connectivity, Graphs, CDS::StubWeight>>(std::move(graphs), CDS::StubWeight(), depth);
+    else if (alpha == 0)
+        return std::make_shared<PreparedSamplerImpl<Connectivity, Graphs, CDS::UniformWeight>>(std::move(graphs), CDS::UniformWeight(), depth);
+    else
+        return std::make_shared<PreparedSamplerImpl<Connectivity, Graphs, CDS::PowerWeight>>(std::move(graphs), CDS::PowerWeight(alpha), depth);
+}
+
+inline std::shared_ptr<const PreparedSampler>
+prepare_sampler(const std::vector<CDS::deg_t> &degrees, bool connected, bool multi, double alpha, int depth) {
+    if (multi) {
+        CDS::MultiGraphs graphs(CDS::DegreeSequenceMulti(degrees.begin(), degrees.end()));
+        return connected ? prepare_sampler<CDS::EquivClass>(std::move(graphs), alpha, depth)
+                         : prepare_sampler<CDS::Unconstrained>(std::move(graphs), alpha, depth);
+    } else {
+        // The same graph type policies as the plain samplers, so that the samples are identical to theirs
+        auto prepare = [&] (auto graphs, auto connectivity) {
+            return prepare_sampler<typename decltype(connectivity)::type>(std::move(graphs), alpha, depth);
+        };
+        CDS::DegreeSequence ds(degrees.begin(), degrees.end());
+        return connected ? CDS::with_simple_graphs<CDS::EquivClass>(std::move(ds), prepare)
+                         : CDS::with_simple_graphs<CDS::Unconstrained>(std::move(ds), prepare);
+    }
+}
+
+// FNV-1a hash of the degree sequence, used as its ID
+inline uint64_t sequence_id(const std::vector<CDS::deg_t> &degrees) {
+    uint64_t h = 0xcbf29ce484222325;
+    auto mix = [&] (uint32_t x) {
+        for (int i=0; i < 4; ++i, x >>= 8)
+            h = (h ^ (x & 0xff)) * 0x100000001b3;
+    };
+    mix(degrees.size());
+    for (const auto &d : degrees)
+        mix(d);
+    return h;
+}
+
+
+// Recently used sequences and their prepared samplers, least recently used evicted first. Thread-safe.
+class SamplerCache {
+    typedef std::tuple<bool, bool, double> Mode; // connected, multi, alpha
+
+    struct Entry {
+        uint64_t id;
+        std::vector<CDS::deg_t> degrees;
+        std::map<Mode, std::shared_ptr<const PreparedSampler>> samplers;
+    };
+
+    typedef std::list<Entry> LRUList; // most recently used first
+
+    const std::size_t capacity;         // maximum number of sequences
+    const int depth;                    // number of edges whose choices the samplers cache
+    static const std::size_t max_modes = 16; // maximum number of samplers per sequence
+
+    std::mutex mutex;
+    LRUList lru;
+    std::unordered_map<uint64_t, LRUList::iterator> index;
+    uint64_t hit_count, miss_count;
+
+    LRUList::iterator touch(uint64_t id) {
+        auto it = index.find(id);
+        if (it == index.end())
+            return lru.end();
+        lru.splice(lru.begin(), lru, it->second);
+        return lru.begin();
+    }
+
+public:
+
+    SamplerCache(std::size_t capacity, int depth) : capacity(std::max<std::size_t>(capacity, 1)), depth(depth), hit_count(0), miss_count(0) { }
+
+    // Register the degree sequence and return its ID
+    uint64_t add_sequence(std::vector<CDS::deg_t> degrees) {
+        const uint64_t id = sequence_id(degrees);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = touch(id);
+        if (it != lru.end()) {
+            if (it->degrees != degrees)
+                throw std::invalid_argument("Sequence ID collision, the sequence cannot be cached.");
+            return id;
+        }
+
+        lru.push_front(Entry{id, std::move(degrees), {}});
+        index[id] = lru.begin();
+        while (lru.size() > capacity) {
+            index.erase(lru.back().id);
+            lru.pop_back();
+        }
+        return id;
+    }
+
+    // Return the sampler for the sequence with the given ID, preparing it if necessary.
+    // Throws std::invalid_argument if the ID is unknown, or the sequence cannot be sampled in this mode.
+    std::shared_ptr<const PreparedSampler> get(uint64_t id, bool connected, bool multi, double alpha) {
+        const Mode mode(connected, multi, alpha);
+        std::vector<CDS::deg_t> degrees;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = touch(id);
+            if (it == lru.end())
+                throw std::invalid_argument("Unknown sequence ID, send the degree sequence instead.");
+            auto found = it->samplers.find(mode);
+            if (found != it->samplers.end()) {
+                hit_count++;
+                return found->second;
+            }
+            miss_count++;
+            degrees = it->degrees;
+        }
+
+        // Prepare without holding the lock, so that other requests are not held up
+        auto sampler = prepare_sampler(degrees, connected, multi, alpha, depth);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = touch(id);
+        if (it != lru.end()) {
+            if (it->samplers.size() >= max_modes && ! it->samplers.count(mode))
+                it->samplers.erase(it->samplers.begin());
+            it->samplers.emplace(mode, sampler);
+        }
+        return sampler;
+    }
+
+    std::size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lru.size();
+    }
+
+    uint64_t hits()   { std::lock_guard<std::mutex> lock(mutex); return hit_count; }
+    uint64_t misses() { std::lock_guard<std::mutex> lock(mutex); return miss_count; }
+};
+
+
+// Latencies of the most recent requests. Thread-safe.
+class LatencyLog {
+    static const std::size_t window = 4096;
+
+    std::mutex mutex;
+    std::vector<double> latencies; // ring buffer
+    std::size_t next;
+
+public:
+
+    LatencyLog() : next(0) { }
+
+    void add(double seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (latencies.size() < window)
+            latencies.push_back(seconds);
+        else
+            latencies[next] = seconds;
+        next = (next + 1) % window;
+    }
+
+    // The recorded latencies in increasing order
+    std::vector<double> sorted() {
+        std::vector<double> result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result = latencies;
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+};
+
+
+class SampleServer {
+    using clock = std::chrono::steady_clock;
+
+    // A client connection. Its requests are read by the thread running run(), and carried out
+    // by the workers one at a time, in order.
+    struct Client {
+        int fd;
+        Connection connection;
+        std::deque<std::pair<std::string, clock::time_point>> requests; // complete frames, with their arrival time
+        std::string error;  // protocol error, reported after the requests before it
+        bool eof;           // no more requests will be read
+        bool busy;          // waiting for or being served by a worker; run() does not touch it then
+
+        explicit Client(int fd) : fd(fd), connection(fd), eof(false), busy(false) { }
+    };
+
+    const std::string path;
+    int listen_fd;
+    int wake_fds[2];    // pipe written by the workers when a connection becomes idle, so that run() polls it again
+
+    SamplerCache cache;
+    LatencyLog latency;
+    std::atomic<uint64_t> request_count, sample_count;
+
+    // All connections, and those with requests waiting for a worker
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    std::map<int, std::unique_ptr<Client>> clients;
+    std::deque<Client *> ready;
+    std::atomic<bool> stopping;   // also read without the mutex, between the samples of a request
+    std::vector<std::thread> workers;
+
+    void handle_sample(PayloadReader &request, Connection &connection) {
+        const uint8_t flags = request.u8();
+        const double alpha = request.f64();
+        const int64_t count = request.i64();
+        const uint64_t seed = request.u64();
+
+        // alpha is part of the cache key, whose ordering a NaN would break for all clients
+        if (! std::isfinite(alpha))
+            throw std::invalid_argument("alpha must be finite.");
+
+        uint64_t id;
+        if (flags & ServerProtocol::flag_by_id) {
+            id = request.u64();
+        } else {
+            const uint32_t n = request.u32();
+            if (request.remaining() != 4 * std::size_t(n))
+                throw ConnectionError("Invalid degree sequence length.");
+            std::vector<CDS::deg_t> degrees(n);
+            for (auto &d : degrees) {
+                uint32_t x = request.u32();
+                if (x > uint32_t(std::numeric_limits<CDS::deg_t>::max()))
+                    throw std::invalid_argument("Degrees are too large.");
+                d = x;
+            }
+            id = cache.add_sequence(std::move(degrees));
+        }
+
+        if (count < 0 || count > ServerProtocol::max_count)
+            throw std::invalid_argument("The sample count must be between 0 and " + std::to_string(ServerProtocol::max_count) + ".");
+
+        auto sampler = cache.get(id, flags & ServerProtocol::flag_connected, flags & ServerProtocol::flag_multi, alpha);
+
+        GraphMessageSink sink(connection);
+        int64_t i = 0;
+        for (; i < count && ! stopping.load(std::memory_order_relaxed); ++i) {
+            CDS::CounterRNG stream(seed, i);
+            sampler->sample(stream, sink);
+        }
+        sample_count += i;
+        if (i < count)
+            throw std::runtime_error("The server is shutting down.");
+
+        connection.send(PayloadWriter(ServerProtocol::end_message).u64(id).i64(count).payload());
+    }
+
+    void handle_stats(Connection &connection) {
+        const std::vector<double> sorted = latency.sorted();
+        auto percentile = [&] (double p) {
+            return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, std::size_t(p * sorted.size()))];
+        };
+
+        connection.send(PayloadWriter(ServerProtocol::stats_message)
+                        .u64(request_count).u64(sample_count)
+                        .u32(cache.size()).u64(cache.hits()).u64(cache.misses())
+                        .u32(sorted.size())
+                        .f64(percentile(0.5)).f64(percentile(0.9)).f64(percentile(0.99))
+                        .f64(sorted.empty() ? 0.0 : sorted.back())
+                        .payload());
+    }
+
+    // Carry out the next request of the client, or report its protocol error.
+    // Returns false if the connection is to be closed.
+    bool serve(Client &client) {
+        Connection &connection = client.connection;
+        try {
+            if (client.requests.empty()) {
+                if (! client.error.empty())
+                    throw ConnectionError(client.error);
+                return false;
+            }
+            const std::string payload = std::move(client.requests.front().first);
+            const auto start = client.requests.front().second;
+            client.requests.pop_front();
+
+            PayloadReader request(payload);
+            const uint8_t type = request.u8();
+
+            try {
+                if (type == ServerProtocol::sample_request)
+                    handle_sample(request, connection);
+                else if (type == ServerProtocol::stats_request)
+                    handle_stats(connection);
+                else
+                    throw ConnectionError("Unknown request type.");
+            } catch (const ConnectionError &) {
+                throw;
+            } catch (const std::exception &e) {
+                connection.send(PayloadWriter(ServerProtocol::error_message).text(e.what()).payload());
+            }
+            connection.flush();
+
+            if (type == ServerProtocol::sample_request) {
+                request_count++;
+                latency.add(std::chrono::duration<double>(clock::now() - start).count());
+            }
+            return true;
+        } catch (const ConnectionError &e) {
+            try {
+                connection.send(PayloadWriter(ServerProtocol::error_message).text(e.what()).payload());
+                connection.flush();
+            } catch (const ConnectionError &) { }
+            return false;
+        }
+    }
+
+    // Called with the mutex held
+    void close_client(Client &client) {
+        ::close(client.fd);
+        clients.erase(client.fd);
+    }
+
+    void wake() {
+        // Fails only if the pipe is full, in which case run() is woken up anyway
+        const char c = 0;
+        ssize_t r = ::write(wake_fds[1], &c, 1);
+        (void) r;
+    }
+
+    // Serve one request at a time, taking turns between the connections
+    void work() {
+        while (true) {
+            Client *client;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready_cv.wait(lock, [&] { return stopping || ! ready.empty(); });
+                if (stopping)
+                    return;
+                client = ready.front();
+                ready.pop_front();
+            }
+
+            const bool open = serve(*client);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (! open) {
+                close_client(*client);
+            } else if (! client->requests.empty() || client->eof) {
+                ready.push_back(client);
+                ready_cv.notify_one();
+            } else {
+                client->busy = false;
+                wake();
+            }
+        }
+    }
+
+    // Read the requests that have arrived on an idle connection, and hand it to the workers if there are any
+    void receive(Client &client) {
+        try {
+            const bool open = client.connection.receive();
+            const auto now = clock::now();
+            std::string payload;
+            while (client.connection.next_frame(payload))
+                client.requests.emplace_back(std::move(payload), now);
+            if (! open) {
+                client.eof = true;
+                if (client.connection.partial())
+                    client.error = "Truncated frame.";
+            }
+        } catch (const ConnectionError &e) {
+            client.eof = true;
+            client.error = e.what();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (client.requests.empty() && client.error.empty()) {
+            if (client.eof)
+                close_client(client);
+        } else {
+            client.busy = true;
+            ready.push_back(&client);
+            ready_cv.notify_one();
+        }
+    }
+
+public:
+
+    // Listen on the Unix domain socket 'path', serving requests with 'threads' worker threads
+    // (0 uses all cores), and caching the state of up to 'cache_size' sequences. The samplers also cache
+    // the choices of the first 'prefix_depth' edges, see PrefixCache.
+    SampleServer(const std::string &path, int threads, std::size_t cache_size = 64, int prefix_depth = 0) :
+        path(path), listen_fd(-1), cache(cache_size, prefix_depth), request_count(0), sample_count(0), stopping(false)
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof addr);
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof addr.sun_path)
+            throw std::invalid_argument("The socket path is too long.");
+        std::strcpy(addr.sun_path, path.c_str());
+
+        // Replace a stale socket left behind by a previous server, but never any other kind of file
+        struct stat st;
+        if (::lstat(path.c_str(), &st) == 0) {
+            if (! S_ISSOCK(st.st_mode))
+                throw std::invalid_argument(path + " exists and is not a socket.");
+            ::unlink(path.c_str());
+        }
+
+        if (::pipe(wake_fds) < 0)
+            throw std::runtime_error(std::string("Could not create pipe: ") + std::strerror(errno));
+        for (int fd : wake_fds)
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0 || ::listen(listen_fd, 64) < 0) {
+            const std::string error = std::strerror(errno);
+            if (listen_fd >= 0)
+                ::close(listen_fd);
+            ::close(wake_fds[0]);
+            ::close(wake_fds[1]);
+            throw std::runtime_error("Could not listen on " + path + ": " + error);
+        }
+
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int t=0; t < threads; ++t)
+            workers.emplace_back(&SampleServer::work, this);
+    }
+
+    SampleServer(const SampleServer &) = delete;
+    SampleServer & operator = (const SampleServer &) = delete;
+
+    ~SampleServer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            // Also unblocks workers writing to clients that do not read. A sample request
+            // being processed ends after the current sample.
+            for (const auto &c : clients)
+                ::shutdown(c.first, SHUT_RDWR);
+        }
+        ready_cv.notify_all();
+        for (auto &th : workers)
+            th.join();
+        for (const auto &c : clients)
+            ::close(c.first);
+        ::close(wake_fds[0]);
+        ::close(wake_fds[1]);
+        ::close(listen_fd);
+        ::unlink(path.c_str());
+    }
+
+    // Accept connections and read requests until stop() returns true. stop() is checked at least every 'poll_ms' milliseconds.
+    void run(const std::function<bool()> &stop, int poll_ms = 200) {
+        // A client closing its connection early must not terminate the server
+        std::signal(SIGPIPE, SIG_IGN);
+
+        std::vector<pollfd> fds;
+        std::vector<Client *> idle;
+        while (! stop()) {
+            // Connections being served are not polled, thus a client sending requests faster than
+            // they are carried out is held up, rather than using more and more memory
+            fds.assign({pollfd{listen_fd, POLLIN, 0}, pollfd{wake_fds[0], POLLIN, 0}});
+            idle.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const auto &c : clients)
+                    if (! c.second->busy) {
+                        fds.push_back(pollfd{c.first, POLLIN, 0});
+                        idle.push_back(c.second.get());
+                    }
+            }
+
+            int r = ::poll(fds.data(), fds.size(), poll_ms);
+            if (r < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("poll() failed: ") + std::strerror(errno));
+            if (r <= 0)
+                continue;
+
+            if (fds[1].revents) {
+                char buf[256];
+                while (::read(wake_fds[0], buf, sizeof buf) > 0)
+                    ;
+            }
+
+            for (std::size_t i=0; i < idle.size(); ++i)
+                if (fds[i+2].revents)
+                    receive(*idle[i]);
+
+            if (fds[0].revents) {
+                int fd = ::accept(listen_fd, nullptr, nullptr);
+                if (fd >= 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    clients.emplace(fd, std::unique_ptr<Client>(new Client(fd)));
+                }
+            }
+        }
+    }
+};
+
+#endif // CDS_SAMPLE_SERVER_H
@@ -0,0 +1,343 @@
+
+#include "Sampler.h"
+#include "ConnSampler.h"
+#include "SamplerMulti.h"
+#include "ConnSamplerMulti.h"
+#include "PopulationSampler.h"
+#include "VertexOrder.h"
+#include "WeightStats.h"
+#include "PrefixCache.h"
+#include "LaneSampler.h"
+
+#include <boost/program_options.hpp>
+#include <random>
+#include <string>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <iomanip>
+#include <tuple>
+#include <numeric>
+#include <sstream>
+
+namespace po = boost::program_options;
+using namespace CDS;
+using namespace std;
+
+
+// A named degree sequence used for benchmarking
+struct Workload {
+    string name;
+    vector<deg_t> degrees;
+};
+
+// Degree sequence with P(d) ~ d^-gamma for dmin <= d <= dmax, made graphical by resampling.
+vector<deg_t> power_law_degrees(int n, double gamma, int dmin, int dmax, mt19937 &rng) {
+    vector<double> weights;
+    for (int d=dmin; d <= dmax; ++d)
+        weights.push_back(pow(d, -gamma));
+    discrete_distribution<> dist(weights.begin(), weights.end());
+
+    while (true) {
+        vector<deg_t> degrees(n);
+        long dsum = 0;
+        for (auto &d : degrees) {
+            d = dist(rng) + dmin;
+            dsum += d;
+        }
+        if (dsum % 2 == 1)
+            degrees[0] += 1;
+        if (DegreeSequence(degrees.begin(), degrees.end()).is_graphical())
+            return degrees;
+    }
+}
+
+// The standard benchmark workloads. These are generated deterministically.
+vector<Workload> standard_workloads() {
+    mt19937 rng(137);
+    vector<Workload> workloads;
+
+    workloads.push_back({"regular", vector<deg_t>(1000, 4)});
+    workloads.push_back({"power-law", power_law_degrees(1000, 2.5, 2, 100, rng)});
+    workloads.push_back({"sparse", power_law_degrees(2000, 1.5, 1, 10, rng)});
+
+    {
+        // Dense sequence with degrees spread around n/2
+        const int n = 200;
+        vector<deg_t> degrees(n);
+        for (int i=0; i < n; ++i)
+            degrees[i] = n/4 + i/2;
+        workloads.push_back({"dense", degrees});
+    }
+
+    {
+        // A few hubs among many low-degree vertices. Each stub of a hub has most of the vertices to choose from.
+        const int n = 3000, hubs = 5;
+        vector<deg_t> degrees(n);
+        for (int i=0; i < n; ++i)
+            degrees[i] = i < hubs ? 500 : 1 + i % 2;
+        if (accumulate(degrees.begin(), degrees.end(), 0) % 2 == 1)
+            degrees.back()++;
+        workloads.push_back({"hubs", degrees});
+    }
+
+    // Small graphs, as sampled in large numbers for motif studies
+    workloads.push_back({"small-regular", vector<deg_t>(32, 3)});
+    workloads.push_back({"small-power-law", power_law_degrees(64, 2.5, 1, 20, rng)});
+    workloads.push_back({"small-128", power_law_degrees(128, 2.5, 1, 30, rng)});
+
+    return workloads;
+}
+
+// Discards the edges and only records the sampling weight
+class StatsSink {
+    WeightStats &stats;
+
+public:
+
+    explicit StatsSink(WeightStats &stats) : stats(stats) { }
+
+    void edge(int, int) { }
+    void finish(double logprob) { stats.add(logprob); }
+};
+
+// Call fun(weight) with the weight policy given by 'spec': power:ALPHA, residual, component:BETA or slack:BETA,
+// see SamplerEngine.h. 'degrees' are the initial degrees, which ResidualWeight uses.
+template<typename Fun>
+void with_weight(const string &spec, const vector<deg_t> &degrees, Fun fun) {
+    const size_t colon = spec.find(':');
+    const string name = spec.substr(0, colon);
+
+    double param = 0;
+    if (colon != string::npos) {
+        istringstream in(spec.substr(colon + 1));
+        if (! (in >> param) || ! in.eof())
+            throw invalid_argument("Invalid parameter in weight policy '" + spec + "'.");
+    }
+
+    if (name == "power" && colon != string::npos) {
+        if (param == 1)
+            fun(StubWeight());
+        else if (param == 0)
+            fun(UniformWeight());
+        else
+            fun(PowerWeight(param));
+    } else if (name == "residual" && colon == string::npos) {
+        fun(ResidualWeight(degrees));
+    } else if (name == "component" && colon != string::npos) {
+        fun(ComponentWeight(param));
+    } else if (name == "slack" && colon != string::npos) {
+        fun(SlackWeight(param));
+    } else {
+        throw invalid_argument("Unknown weight policy '" + spec + "'.");
+    }
+}
+
+// Generate a single sample with the given weight policy, using the same graph type policies as sample(), sample_conn(),
+// sample_multi() and sample_conn_multi()
+template<typename Weight, typename RNG, typename Sink>
+void sample_with_weight(const vector<deg_t> &degrees, bool connected, bool multi, const Weight &weight, RNG &rng, Sink &sink) {
+    if (multi) {
+        MultiGraphs graphs(DegreeSequenceMulti(degrees.begin(), degrees.end()));
+        if (connected)
+            sample_engine<EquivClass>(move(graphs), weight, rng, sink);
+        else
+            sample_engine<Unconstrained>(move(graphs), weight, rng, sink);
+    } else {
+        auto sample_graphs = [&] (auto graphs, auto connectivity) {
+            sample_engine<typename decltype(connectivity)::type>(move(graphs), weight, rng, sink);
+        };
+        DegreeSequence ds(degrees.begin(), degrees.end());
+        if (connected)
+            with_simple_graphs<EquivClass>(move(ds), sample_graphs);
+        else
+            with_simple_graphs<Unconstrained>(move(ds), sample_graphs);
+    }
+}
+
+// Generate 'count' samples with the given settings and report timing and effective sample size.
+// With population > 0, samples are generated in populations of that size using sequential importance resampling.
+// With cache_depth > 0, samples are generated through a PrefixCache of that depth. Its setup is included in the timing.
+// With lanes set, samples are generated by SmallGraphLanes.
+// With a non-empty 'weight_spec', plain samples are generated with that weight policy, see with_weight(), instead of alpha.
+// ESS per second is computed from CPU time summed over all threads, to make single- and multi-threaded runs comparable.
+void run(const Workload &workload, bool connected, bool multi, double alpha, const string &weight_spec, const string &order_name,
+         int population, int cache_depth, bool lanes, ThreadPool &pool, long count, unsigned long seed)
+{
+    mt19937 rng(seed);
+
+    Relabelling relabelling(workload.degrees, parse_vertex_order(order_name), rng);
+    const vector<deg_t> degrees = relabelling.apply(workload.degrees);
+
+    WeightStats stats;
+    StatsSink sink(stats);
+
+    auto start = chrono::steady_clock::now();
+    clock_t cpu_start = clock();
+    if (! weight_spec.empty()) {
+        with_weight(weight_spec, degrees, [&] (const auto &weight) {
+            for (long i=0; i < count; ++i)
+                sample_with_weight(degrees, connected, multi, weight, rng, sink);
+        });
+    } else if (lanes) {
+        sample_small(DegreeSequence(degrees.begin(), degrees.end()), alpha, count, rng, [&] (long) { return sink; });
+    } else if (cache_depth > 0) {
+        auto sample_all = [&] (const auto &cache) {
+            for (long i=0; i < count; ++i)
+                cache.sample(rng, sink);
+            return 0;
+        };
+        if (multi)
+            with_prefix_cache(DegreeSequenceMulti(degrees.begin(), degrees.end()), connected, alpha, cache_depth, size_t(1) << 22, sample_all);
+        else
+            with_prefix_cache(DegreeSequence(degrees.begin(), degrees.end()), connected, alpha, cache_depth, size_t(1) << 22, sample_all);
+    } else if (population == 0) {
+        for (long i=0; i < count; ++i) {
+            if (multi) {
+                DegreeSequenceMulti ds(degrees.begin(), degrees.end());
+                if (connected)
+                    sample_conn_multi(ds, alpha, rng, sink);
+                else
+                    sample_multi(ds, alpha, rng, sink);
+            } else {
+                DegreeSequence ds(degrees.begin(), degrees.end());
+                if (connected)
+                    sample_conn(ds, alpha, rng, sink);
+                else
+                    sample(ds, alpha, rng, sink);
+            }
+        }
+    } else {
+        for (long i=0; i < count; i += population) {
+            vector<tuple<edgelist_t, double>> samples;
+            if (multi) {
+                DegreeSequenceMulti ds(degrees.begin(), degrees.end());
+                if (connected)
+                    samples = sample_conn_multi_population(ds, alpha, population, rng, pool);
+                else
+                    samples = sample_multi_population(ds, alpha, population, rng, pool);
+            } else {
+                DegreeSequence ds(degrees.begin(), degrees.end());
+                if (connected)
+                    samples = sample_conn_population(ds, alpha, population, rng, pool);
+                else
+                    samples = sample_population(ds, alpha, population, rng, pool);
+            }
+            for (const auto &sample : samples)
+                stats.add(get<1>(sample));
+        }
+    }
+    clock_t cpu_end = clock();
+    auto end = chrono::steady_clock::now();
+
+    double seconds = chrono::duration<double>(end - start).count();
+    double cpu_seconds = double(cpu_end - cpu_start) / CLOCKS_PER_SEC;
+
+    cout << workload.name << '\t'
+         << order_name << '\t'
+         << (! weight_spec.empty() ? weight_spec : lanes ? "lanes-8" : cache_depth > 0 ? "prefix-" + to_string(cache_depth) : population > 0 ? "sir-" + to_string(population) : string("plain")) << '\t'
+         << stats.sample_count() / seconds << '\t'
+         << stats.ess() << '\t'
+         << stats.ess() / cpu_seconds << '\n';
+}
+
+int main(int argc, char *argv[]) {
+
+    try {
+
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("help,h", "produce help message")
+            ("workload,w",  po::value<vector<string>>()->multitoken(),  "run only the given workloads")
+            ("order,o",     po::value<vector<string>>()->multitoken()->default_value({"input", "desc-degree", "asc-degree", "random"}, "all"),
+                                                                         "vertex processing orders to compare")
+            ("connected,c", po::bool_switch(),                           "generate connected graphs")
+            ("multi,m",     po::bool_switch(),                           "generate loop-free multigraphs")
+            ("alpha,a",     po::value<double>()->default_value(1.0),     "set parameter for the heuristic")
+            ("count,n",     po::value<long>()->default_value(100L),      "how many graphs to generate per measurement")
+            ("population,p", po::value<vector<int>>()->multitoken(),     "also measure population mode with the given population sizes")
+            ("prefix-cache", po::value<vector<int>>()->multitoken(),     "also measure sampling through a prefix cache of the given depths")
+            ("weights",     po::value<vector<string>>()->multitoken(),  "also measure plain sampling with the given weight policies: power:ALPHA, residual, component:BETA, slack:BETA")
+            ("lanes",       po::bool_switch(),                           "also measure the multi-lane engine on the workloads with at most 64 vertices, for unconstrained simple graphs")
+            ("threads,t",   po::value<int>()->default_value(0),          "number of threads for population mode, 0 uses all cores")
+            ("seed,s",      po::value<unsigned long>()->default_value(42), "set random seed")
+        ;
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help")) {
+            cout << "Usage:\n"
+                 << argv[0] << " [options]\n\n"
+                 << "Reports samples per second, effective sample size (ESS) and ESS per CPU-second\n"
+                 << "for each standard workload and vertex processing order, using plain sampling\n"
+                 << "and optionally population mode (sequential importance resampling), a prefix cache,\n"
+                 << "the multi-lane engine, or other weight policies.\n\n"
+                 << desc << "\n";
+            return 0;
+        }
+
+        vector<string> selected;
+        if (vm.count("workload"))
+            selected = vm["workload"].as<vector<string>>();
+
+        vector<int> populations = {0};
+        if (vm.count("population"))
+            for (int p : vm["population"].as<vector<int>>()) {
+                if (p < 1)
+                    throw invalid_argument("Population sizes must be positive.");
+                populations.push_back(p);
+            }
+
+        vector<int> cache_depths;
+        if (vm.count("prefix-cache"))
+            for (int d : vm["prefix-cache"].as<vector<int>>()) {
+                if (d < 1)
+                    throw invalid_argument("Prefix cache depths must be positive.");
+                cache_depths.push_back(d);
+            }
+
+        vector<string> weight_specs;
+        if (vm.count("weights"))
+            for (const auto &spec : vm["weights"].as<vector<string>>()) {
+                with_weight(spec, vector<deg_t>(), [] (const auto &) { }); // check the syntax before any output
+                weight_specs.push_back(spec);
+            }
+
+        const bool lanes = vm["lanes"].as<bool>();
+        if (lanes && (vm["connected"].as<bool>() || vm["multi"].as<bool>()))
+            throw invalid_argument("The multi-lane engine only samples unconstrained simple graphs.");
+
+        ThreadPool pool(vm["threads"].as<int>());
+
+        cout << setprecision(4);
+        cout << "workload\torder\tmethod\tsamples/s\tESS\tESS/cpu-s\n";
+
+        for (const auto &workload : standard_workloads()) {
+            if (! selected.empty() && find(selected.begin(), selected.end(), workload.name) == selected.end())
+                continue;
+
+            for (const auto &order : vm["order"].as<vector<string>>()) {
+                for (int population : populations)
+                    run(workload, vm["connected"].as<bool>(), vm["multi"].as<bool>(), vm["alpha"].as<double>(), "",
+                        order, population, 0, false, pool, vm["count"].as<long>(), vm["seed"].as<unsigned long>());
+                for (int depth : cache_depths)
+                    run(workload, vm["connected"].as<bool>(), vm["multi"].as<bool>(), vm["alpha"].as<double>(), "",
+                        order, 0, depth, false, pool, vm["count"].as<long>(), vm["seed"].as<unsigned long>());
+                for (const auto &spec : weight_specs)
+                    run(workload, vm["connected"].as<bool>(), vm["multi"].as<bool>(), vm["alpha"].as<double>(), spec,
+                        order, 0, 0, false, pool, vm["count"].as<long>(), vm["seed"].as<unsigned long>());
+                if (lanes && workload.degrees.size() <= size_t(SmallGraphLanes<>::max_vertices))
+                    run(workload, false, false, vm["alpha"].as<double>(), "",
+                        order, 0, 0, true, pool, vm["count"].as<long>(), vm["seed"].as<unsigned long>());
+            }
+        }
+    }
+    catch(exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+
+#include "Common.h"
+#include "VertexOrder.h"
+#include "StoppingRule.h"
+
+#include "NpyArray.h"
+#include "AsyncWriter.h"
+#include "Observables.h"
+#include "SampleIO.h"
+
+#include <boost/program_options.hpp>
+#include <random>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace po = boost::program_options;
+using namespace CDS;
+using namespace std;
+
+
+// Merges the outputs of all shards of a cdsample --shard run into the output of the equivalent
+// single-process run, i.e. the run with --shard 0/1. Samples are taken from the shards in order of their
+// global index, and the summary is recomputed from them in the same order, thus both the samples and the
+// summary are identical to those of the single-process run.
+
+int main(int argc, char *argv[]) {
+
+    try {
+
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("help,h", "produce help message")
+            ("input",  po::value<vector<string>>(), "shard outputs: text files, or NumPy file prefixes")
+            ("npy",    po::value<string>(),         "write the result as NumPy arrays, using the given file name prefix")
+        ;
+
+        po::positional_options_description p;
+        p.add("input", -1);
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).
+                  options(desc).positional(p).run(), vm);
+        po::notify(vm);
+
+        if (vm.count("help") || ! vm.count("input")) {
+            if (! vm.count("help"))
+                cerr << "Error: No input files were given!\n";
+
+            cout << "Usage:\n"
+                 << argv[0] << " shard_0.txt shard_1.txt ...\n"
+                 << argv[0] << " --npy output_prefix shard_0_prefix shard_1_prefix ...\n\n"
+                 << desc << "\n";
+
+            if (vm.count("help"))
+                return 0;
+            else
+                return 1;
+        }
+
+        // Open the shards and check that together they make up a complete run
+
+        vector<unique_ptr<SampleReader>> readers;
+        for (const auto &name : vm["input"].as<vector<string>>())
+            readers.push_back(open_samples(name));
+
+        const long shards = readers.size();
+        const ShardInfo &first = readers[0]->info();
+
+        if (first.shards != shards) {
+            cerr << "Error: The run has " << first.shards << " shards, but " << shards << " were given!\n";
+            return 1;
+        }
+
+        vector<unique_ptr<SampleReader>> by_index(shards);
+        for (auto &reader : readers) {
+            const ShardInfo &info = reader->info();
+            if (! info.same_run(first)) {
+                cerr << "Error: The shards do not come from the same run!\n";
+                return 1;
+            }
+            if (by_index[info.index]) {
+                cerr << "Error: Shard " << info.index << " was given more than once!\n";
+                return 1;
+            }
+            by_index[info.index] = move(reader);
+        }
+
+        ShardInfo merged = first;
+        merged.index = 0;
+        merged.shards = 1;
+
+        vector<Statistic> stats;
+        for (const auto &name : merged.stats)
+            stats.push_back(parse_statistic(name));
+
+        // Read samples in order of their global index
+
+        const int n = merged.vertices;
+        long next_index = 0;
+        edgelist_t edges;
+        double logprob;
+
+        auto read_next = [&] () {
+            if (! by_index[next_index % shards]->next(edges, logprob))
+                throw runtime_error("Shard " + to_string(next_index % shards) + " has fewer samples than expected.");
+            for (const auto &e : edges)
+                if (e.first < 0 || e.first >= n || e.second < 0 || e.second >= n)
+                    throw runtime_error("Shard " + to_string(next_index % shards) + " contains an invalid vertex.");
+            next_index++;
+        };
+
+        // All samples have the same degrees, so they can be determined from the first one.
+        vector<deg_t> degrees(n);
+        if (merged.count > 0) {
+            read_next();
+            for (const auto &e : edges) {
+                degrees[e.first]++;
+                degrees[e.second]++;
+            }
+        }
+        const size_t m = edges.size();
+
+        mt19937 rng;
+        Relabelling identity(degrees, VertexOrder::Input, rng);
+
+        StoppingRule rule(0, 0, 0, stats.size());
+        Observer observer(degrees, stats, rule);
+
+        // Pass all samples to the sink returned by 'sink_for(i)'
+        auto merge = [&] (auto sink_for, auto done) {
+            for (long i=0; i < merged.count; ++i) {
+                if (i > 0)
+                    read_next();
+                if (edges.size() != m)
+                    throw runtime_error("Shard " + to_string(i % shards) + " contains a sample with a different edge count.");
+
+                auto sink = make_observing_sink(sink_for(i), observer);
+                for (const auto &e : edges)
+                    sink.edge(e.first, e.second);
+                sink.finish(logprob);
+                done();
+            }
+
+            for (long k=0; k < shards; ++k)
+                if (by_index[k]->next(edges, logprob))
+                    throw runtime_error("Shard " + to_string(k) + " has more samples than expected.");
+        };
+
+        if (vm.count("npy")) {
+            const string prefix = vm["npy"].as<string>();
+            NpyArray<int32_t> npy_edges(prefix + "_edges.npy", {merged.count*m, 2});
+            NpyArray<int64_t> npy_offsets(prefix + "_offsets.npy", {size_t(merged.count)+1});
+            NpyArray<double>  npy_logprobs(prefix + "_logprob.npy", {size_t(merged.count)});
+
+            for (long i=0; i <= merged.count; ++i)
+                npy_offsets[i] = i*m;
+
+            ofstream info(prefix + "_shard.txt");
+            info << merged.to_string() << '\n';
+            if (! info) {
+                cerr << "Error: Could not write " << prefix << "_shard.txt!\n";
+                return 1;
+            }
+
+            merge([&] (long i) { return NpySink(npy_edges.data() + 2*i*m, npy_logprobs.data() + i, identity); },
+                  [] () { });
+        } else {
+            cout << merged.to_string() << '\n';
+            cout.flush();
+            AsyncTextWriter writer(stdout, identity, m);
+
+            merge([&] (long) { return AsyncTextWriter::Sink(writer.acquire()); },
+                  [&] () { writer.publish(); });
+
+            writer.close();
+            if (writer.failed()) {
+                cerr << "Error: Could not write output!\n";
+                return 1;
+            }
+        }
+
+        print_summary(cerr, merged.count, rule, stats);
+    }
+    catch(exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    catch(...) {
+        cerr << "Exception of unknown type!\n";
+    }
+
+    return 0;
+}
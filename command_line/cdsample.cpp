@@ -3,19 +3,355 @@
 #include "ConnSampler.h"
 #include "SamplerMulti.h"
 #include "ConnSamplerMulti.h"
+#include "PopulationSampler.h"
+#include "ParallelSampler.h"
+#include "EdgeSwapChain.h"
+#include "Autocorrelation.h"
+#include "WeightStats.h"
+#include "StoppingRule.h"
+#include "VertexOrder.h"
+#include "CounterRNG.h"
+#include "ConfigurationModel.h"
+#include "Graphicality.h"
+#include "PrefixCache.h"
+
+#include "NpyArray.h"
+#include "AsyncWriter.h"
+#include "Observables.h"
+#include "SampleIO.h"
+#include "SampleServer.h"
 
 #include <boost/program_options.hpp>
 #include <random>
 #include <string>
-#include <limits>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <memory>
+#include <cstdint>
+#include <tuple>
+#include <cmath>
+#include <limits>
+#include <csignal>
+#include <cstdlib>
+#include <cctype>
 
 namespace po = boost::program_options;
 using namespace CDS;
 using namespace std;
 
 
+// Set by the SIGINT handler. Sampling stops as soon as the flag is noticed, and the samples completed so far are written out.
+volatile sig_atomic_t interrupted = 0;
+
+extern "C" void on_interrupt(int) {
+    interrupted = 1;
+    signal(SIGINT, SIG_DFL); // a second Ctrl-C terminates immediately
+}
+
+// Cancels the sample under construction on SIGINT. Polled by the samplers about every thousand edges.
+auto interrupt_control() {
+    return make_sample_control([] (const Progress &) { return interrupted != 0; });
+}
+
+
+// Generate a single sample of the requested type. Throws SamplingCancelled if 'control' cancels it.
+// If 'pool' is not null, the work within the sample is split across its threads. This does not change the sample.
+template<typename RNG, typename Sink, typename Control>
+void generate(const vector<deg_t> &degrees, bool multi, bool connected, double alpha, RNG &rng, Sink &sink, Control &control,
+              ThreadPool *pool = nullptr)
+{
+    if (multi) {
+        DegreeSequenceMulti ds(degrees.begin(), degrees.end());
+        if (pool) {
+            if (connected)
+                sample_conn_multi_parallel(ds, alpha, rng, sink, *pool, control);
+            else
+                sample_multi_parallel(ds, alpha, rng, sink, *pool, control);
+        } else {
+            if (connected)
+                sample_conn_multi(ds, alpha, rng, sink, control);
+            else
+                sample_multi(ds, alpha, rng, sink, control);
+        }
+    } else {
+        DegreeSequence ds(degrees.begin(), degrees.end());
+        if (pool) {
+            if (connected)
+                sample_conn_parallel(ds, alpha, rng, sink, *pool, control);
+            else
+                sample_parallel(ds, alpha, rng, sink, *pool, control);
+        } else {
+            if (connected)
+                sample_conn(ds, alpha, rng, sink, control);
+            else
+                sample(ds, alpha, rng, sink, control);
+        }
+    }
+}
+
+// Generate a single sample using the configuration model with rejection if it is expected to accept often enough,
+// and the sequential sampler otherwise, see ConfigurationModel.h. Only unconstrained sampling is supported.
+template<typename RNG, typename Sink, typename Control>
+void generate_configuration(const vector<deg_t> &degrees, bool multi, double alpha, RNG &rng, Sink &sink, Control &control) {
+    if (multi)
+        sample_multi_cm(DegreeSequenceMulti(degrees.begin(), degrees.end()), alpha, rng, sink, control);
+    else
+        sample_cm(DegreeSequence(degrees.begin(), degrees.end()), alpha, rng, sink, control);
+}
+
+
+// Generate a population of samples of the requested type using sequential importance resampling.
+template<typename RNG>
+vector<tuple<edgelist_t, double>>
+generate_population(const vector<deg_t> &degrees, bool multi, bool connected, double alpha, int size, RNG &rng, ThreadPool &pool) {
+    if (multi) {
+        DegreeSequenceMulti ds(degrees.begin(), degrees.end());
+        if (connected)
+            return sample_conn_multi_population(ds, alpha, size, rng, pool);
+        else
+            return sample_multi_population(ds, alpha, size, rng, pool);
+    } else {
+        DegreeSequence ds(degrees.begin(), degrees.end());
+        if (connected)
+            return sample_conn_population(ds, alpha, size, rng, pool);
+        else
+            return sample_population(ds, alpha, size, rng, pool);
+    }
+}
+
+// Generate up to 'count' samples and pass each to the sink returned by 'sink_for(i)'.
+// After each sample, 'done()' is called; generation stops early if it returns true.
+// Returns the number of samples completed. A sample cancelled by 'control' is not counted.
+// Without population mode, samples are generated independently, using 'sample_pool' within each sample if it is not null,
+// or with generate_configuration() if 'config_model' is set. In population mode,
+// populations of 'population' samples are generated until there are enough samples, and 'count' must be
+// a multiple of 'population'. Generation only stops after a whole population, however early 'done()' returns true;
+// populations are not polled, so 'done()' is the only way to stop early.
+template<typename RNG, typename SinkFor, typename Done, typename Control>
+long generate_all(const vector<deg_t> &degrees, bool multi, bool connected, bool config_model, double alpha, long count,
+                  int population, int threads, RNG &rng, SinkFor sink_for, Done done, Control &control, ThreadPool *sample_pool)
+{
+    if (population == 0) {
+        for (long i=0; i < count; ) {
+            auto sink = sink_for(i);
+            try {
+                if (config_model)
+                    generate_configuration(degrees, multi, alpha, rng, sink, control);
+                else
+                    generate(degrees, multi, connected, alpha, rng, sink, control, sample_pool);
+            } catch (const SamplingCancelled &) {
+                return i;
+            }
+            i++;
+            if (done())
+                return i;
+        }
+        return count;
+    }
+
+    ThreadPool pool(threads);
+    for (long i=0; i < count; ) {
+        bool stop = false;
+        for (auto &sample : generate_population(degrees, multi, connected, alpha, population, rng, pool)) {
+            auto sink = sink_for(i++);
+            for (const auto &e : get<0>(sample))
+                sink.edge(e.first, e.second);
+            sink.finish(get<1>(sample));
+            if (done())
+                stop = true;
+        }
+        if (stop)
+            return i;
+    }
+    return count;
+}
+
+// Generate up to 'count' samples through a PrefixCache, which caches the choices of the first 'depth' edges,
+// shared between all samples. 'sink_for(i)' and 'done()' are as in generate_all(). A sample cannot be cancelled
+// once started, so SIGINT takes effect after the current sample.
+template<typename RNG, typename SinkFor, typename Done>
+long generate_cached(const vector<deg_t> &degrees, bool multi, bool connected, double alpha, long count, int depth,
+                     RNG &rng, SinkFor sink_for, Done done)
+{
+    auto sample_all = [&] (const auto &cache) {
+        for (long i=0; i < count; ) {
+            auto sink = sink_for(i);
+            cache.sample(rng, sink);
+            i++;
+            if (done())
+                return i;
+        }
+        return count;
+    };
+
+    if (multi)
+        return with_prefix_cache(DegreeSequenceMulti(degrees.begin(), degrees.end()), connected, alpha, depth, size_t(1) << 22, sample_all);
+    else
+        return with_prefix_cache(DegreeSequence(degrees.begin(), degrees.end()), connected, alpha, depth, size_t(1) << 22, sample_all);
+}
+
+// Generate the samples of one shard: those with global index i = shard, shard + shards, ... below 'count'.
+// Sample i is generated from its own random stream, CounterRNG(seed, i), so that the samples do not depend on
+// the number of shards. 'sink_for(j)', 'done()', 'control' and 'sample_pool' are as in generate_all(), with j counting the samples of this shard.
+template<typename SinkFor, typename Done, typename Control>
+long generate_shard(const vector<deg_t> &degrees, bool multi, bool connected, double alpha, long count,
+                    long shard, long shards, uint64_t seed, SinkFor sink_for, Done done, Control &control, ThreadPool *sample_pool)
+{
+    long j = 0;
+    for (long i = shard; i < count; i += shards) {
+        CounterRNG stream(seed, i);
+        auto sink = sink_for(j);
+        try {
+            generate(degrees, multi, connected, alpha, stream, sink, control, sample_pool);
+        } catch (const SamplingCancelled &) {
+            break;
+        }
+        j++;
+        if (done())
+            break;
+    }
+    return j;
+}
+
+
+// Classify the degree sequences read from 'in', one per line, and write one line per sequence to 'out' with three
+// columns: 1 or 0 for graphical, multigraphical and potentially connected. Sequences are read and classified in blocks,
+// in parallel using 'pool'. Throws std::runtime_error on a line which is not a list of integers.
+void check_sequences(istream &in, ostream &out, ThreadPool &pool) {
+    const long block_size = 1 << 20;
+
+    vector<long> values;
+    vector<long> offsets;
+    vector<unsigned char> classes;
+    string line;
+    long line_number = 0;
+
+    while (in) {
+        values.clear();
+        offsets.assign(1, 0);
+        while (long(offsets.size()) <= block_size && getline(in, line)) {
+            line_number++;
+            const char *p = line.c_str();
+            while (true) {
+                char *end;
+                long d = strtol(p, &end, 10);
+                if (end == p)
+                    break;
+                values.push_back(d);
+                p = end;
+            }
+            while (isspace(static_cast<unsigned char>(*p)))
+                ++p;
+            if (*p != '\0')
+                throw runtime_error("Unexpected input in line " + to_string(line_number) + ".");
+            offsets.push_back(values.size());
+        }
+
+        const long count = offsets.size() - 1;
+        classes.resize(count);
+        classify_sequences(values.data(), offsets.data(), count, classes.data(), pool);
+
+        for (const auto &c : classes)
+            out << bool(c & SequenceClass::graphical) << '\t'
+                << bool(c & SequenceClass::multigraphical) << '\t'
+                << bool(c & SequenceClass::potentially_connected) << '\n';
+    }
+}
+
+
+// Parse a duration such as 90, 90s, 10m, 1.5h into seconds.
+double parse_duration(const string &text) {
+    size_t pos = 0;
+    double value;
+    try {
+        value = stod(text, &pos);
+    } catch (const logic_error &) {
+        throw invalid_argument("Invalid duration '" + text + "'.");
+    }
+
+    const string unit = text.substr(pos);
+    double scale;
+    if (unit == "" || unit == "s")
+        scale = 1;
+    else if (unit == "m")
+        scale = 60;
+    else if (unit == "h")
+        scale = 3600;
+    else
+        throw invalid_argument("Invalid duration '" + text + "'. Use one of the units s, m or h.");
+
+    if (! (value >= 0))
+        throw invalid_argument("Durations must be non-negative.");
+    return value*scale;
+}
+
+
+// Print the integrated autocorrelation time and related diagnostics of a statistic recorded along the chain.
+void print_autocorrelation(const string &name, const vector<double> &series) {
+    double tau = integrated_autocorrelation_time(series);
+    cerr << name << '\t';
+    if (std::isnan(tau))
+        cerr << "constant\n";
+    else
+        cerr << autocorrelation(series, 1) << '\t' << tau << '\t' << series.size() / tau << '\n';
+}
+
+// Generate up to 'count' simple graphs using the edge swap Markov chain, with 'steps' swap attempts between samples.
+// The chain is started from one of 'init' samples of the importance sampler, chosen in proportion to its weight,
+// then run for 'burn_in' steps. All samples are reported with logprob 0, as they are (asymptotically) uniform.
+// Acceptance rate and autocorrelation diagnostics are printed to the standard error.
+// As in generate_all(), generation stops early if 'done()' returns true, and the number of samples is returned.
+template<typename RNG, typename SinkFor, typename Done>
+long generate_mcmc(const vector<deg_t> &degrees, bool connected, double alpha, long count,
+                   long steps, long burn_in, int init, RNG &rng, SinkFor sink_for, Done done)
+{
+    // Choose the starting graph from 'init' weighted samples
+    edgelist_t start;
+    WeightStats stats;
+    for (int k=0; k < init; ++k) {
+        EdgeListSink sink;
+        NoControl control;
+        generate(degrees, false, connected, alpha, rng, sink, control);
+        edgelist_t edges; double logprob;
+        tie(edges, logprob) = sink.result();
+
+        stats.add(logprob);
+        if (uniform_real_distribution<double>()(rng) < exp(-logprob - stats.log_weight_sum()))
+            start = move(edges);
+    }
+
+    EdgeSwapChain chain(degrees.size(), move(start), connected);
+    chain.run(burn_in, rng);
+    const long burn_in_accepted = chain.accepted();
+
+    vector<double> assortativity, triangles;
+    for (long i=0; i < count; ++i) {
+        if (i > 0)
+            chain.run(steps, rng);
+
+        auto sink = sink_for(i);
+        for (const auto &e : chain.edges())
+            sink.edge(e.first, e.second);
+        sink.finish(0);
+
+        assortativity.push_back(degree_assortativity(chain.edges(), degrees));
+        triangles.push_back(chain.triangle_count());
+
+        if (done())
+            count = i+1;
+    }
+
+    if (count > 1)
+        cerr << "Acceptance rate: " << double(chain.accepted() - burn_in_accepted) / ((count - 1)*steps) << '\n';
+    cerr << "statistic\trho(1)\ttau\tESS\n";
+    print_autocorrelation("assortativity", assortativity);
+    print_autocorrelation("triangles", triangles);
+
+    return count;
+}
+
+
 int main(int argc, char *argv[]) {
 
     try {
@@ -30,8 +366,25 @@ int main(int argc, char *argv[]) {
             ("connected,c", po::bool_switch(),                        "generate connected graphs")
             ("multi,m",     po::bool_switch(),                        "generate loop-free multigraphs")
             ("alpha,a",     po::value<double>()->default_value(1.0),  "set parameter for the heuristic")
-            ("count,n",     po::value<long>()->default_value(1L),     "how many graphs to generate")
+            ("count,n",     po::value<long>()->default_value(1L),     "how many graphs to generate, or the maximum number when using a stopping target")
             ("seed,s",      po::value<long>(),                        "set random seed")
+            ("order,o",     po::value<string>()->default_value("input"), "vertex processing order: input, desc-degree, asc-degree or random")
+            ("npy",         po::value<string>(),                      "write samples as NumPy arrays, using the given file name prefix")
+            ("population,p", po::value<int>()->default_value(0),      "generate populations of the given size using sequential importance resampling; --count is rounded up to whole populations")
+            ("threads,t",   po::value<int>()->default_value(0),       "number of threads for population mode and --parallel-sample, 0 uses all cores")
+            ("parallel-sample", po::bool_switch(),                    "split the work within each sample across threads, for very large graphs; the samples do not change")
+            ("prefix-cache", po::value<int>()->default_value(0),      "cache the choices of the first D edges, shared between the samples, to speed up many samples of one sequence; also in server mode")
+            ("config-model", po::bool_switch(),                       "use the configuration model with rejection when it is expected to be faster, for sparse sequences")
+            ("mcmc-steps",  po::value<long>()->default_value(0),      "generate correlated uniform samples using an edge swap Markov chain, with the given number of swap attempts between samples")
+            ("mcmc-burn-in", po::value<long>(),                       "number of swap attempts before the first sample (default: 10 times the edge count)")
+            ("mcmc-init",   po::value<int>()->default_value(1),       "choose the starting graph of the chain from this many weighted samples")
+            ("target-ess",  po::value<double>(),                      "stop once the effective sample size reaches this value")
+            ("target-relerr", po::value<double>(),                    "stop once the relative standard error of the weighted mean of each --stat falls below this value")
+            ("stat",        po::value<vector<string>>()->multitoken(), "statistics to estimate: assortativity, triangles")
+            ("time-budget", po::value<string>(),                      "stop after the given time, e.g. 30s, 10m or 2h")
+            ("shard",       po::value<string>(),                      "generate shard K/N of the samples from the seed; merge shards with cdsample-merge")
+            ("check",       po::bool_switch(),                        "only classify degree sequences as graphical, multigraphical and potentially connected; the input file has one sequence per line")
+            ("serve",       po::value<string>(),                      "run as a sampling server on the given Unix socket, using --threads workers; see README")
         ;
 
         po::positional_options_description p;
@@ -42,13 +395,15 @@ int main(int argc, char *argv[]) {
                   options(desc).positional(p).run(), vm);
         po::notify(vm);
 
-        if (vm.count("help") || ! (vm.count("file") || vm.count("degrees"))) {
+        if (vm.count("help") || ! (vm.count("file") || vm.count("degrees") || vm.count("serve"))) {
             if (! vm.count("help"))
                 cerr << "Error: No degree sequence was given!\n";
 
             cout << "Usage:\n"
                  << argv[0] << " input_file\n"
-                 << argv[0] << " --degrees d1 d2 d3\n\n"
+                 << argv[0] << " --degrees d1 d2 d3\n"
+                 << argv[0] << " --check input_file\n"
+                 << argv[0] << " --serve socket_path\n\n"
                  << desc << "\n";
 
             if (vm.count("help"))
@@ -62,10 +417,170 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
+        // Check mode: classify the sequences without sampling
+
+        if (vm["check"].as<bool>()) {
+            ThreadPool pool(vm["threads"].as<int>());
+            if (vm.count("file")) {
+                ifstream dsfile(vm["file"].as<string>());
+
+                if (! dsfile) {
+                    cerr << "Error: Could not open " << vm["file"].as<string>() << "!\n";
+                    return 1;
+                }
+
+                check_sequences(dsfile, cout, pool);
+            } else {
+                ostringstream line;
+                for (const auto &d : vm["degrees"].as<vector<deg_t>>())
+                    line << d << ' ';
+                istringstream in(line.str());
+                check_sequences(in, cout, pool);
+            }
+            return 0;
+        }
+
+        // Server mode: degree sequences and sampling options come with the requests
+
+        if (vm.count("serve")) {
+            if (vm.count("file") || vm.count("degrees")) {
+                cerr << "Error: In server mode, degree sequences are sent by the clients!\n";
+                return 1;
+            }
+
+            const int cache_depth = vm["prefix-cache"].as<int>();
+            if (cache_depth < 0) {
+                cerr << "Error: The prefix cache depth must be non-negative!\n";
+                return 1;
+            }
+
+            SampleServer server(vm["serve"].as<string>(), vm["threads"].as<int>(), 64, cache_depth);
+            signal(SIGINT, on_interrupt);
+            signal(SIGTERM, on_interrupt);
+            cerr << "Listening on " << vm["serve"].as<string>() << ".\n";
+            server.run([] () { return interrupted != 0; });
+            cerr << "Shutting down.\n";
+            return 0;
+        }
+
         // Read program options and degree sequence
 
         double alpha = vm["alpha"].as<double>();
         long n = vm["count"].as<long>();
+        VertexOrder order = parse_vertex_order(vm["order"].as<string>());
+        int population = vm["population"].as<int>();
+        int threads = vm["threads"].as<int>();
+
+        if (n < 0) {
+            cerr << "Error: The sample count must be non-negative!\n";
+            return 1;
+        }
+
+        if (population < 0) {
+            cerr << "Error: The population size must be non-negative!\n";
+            return 1;
+        }
+
+        long mcmc_steps = vm["mcmc-steps"].as<long>();
+        int mcmc_init = vm["mcmc-init"].as<int>();
+
+        if (mcmc_steps < 0 || mcmc_init < 1) {
+            cerr << "Error: The number of MCMC steps must be non-negative and the number of initial samples must be positive!\n";
+            return 1;
+        }
+
+        const bool parallel_sample = vm["parallel-sample"].as<bool>();
+        if (parallel_sample && population > 0) {
+            cerr << "Error: --parallel-sample cannot be combined with population mode, which already runs samples in parallel!\n";
+            return 1;
+        }
+
+        if (mcmc_steps > 0 && (vm["multi"].as<bool>() || population > 0)) {
+            cerr << "Error: MCMC mode cannot be combined with multigraphs or population mode!\n";
+            return 1;
+        }
+
+        const bool config_model = vm["config-model"].as<bool>();
+        if (config_model && (vm["connected"].as<bool>() || population > 0 || parallel_sample || mcmc_steps > 0)) {
+            cerr << "Error: --config-model cannot be combined with connected graphs, population mode, --parallel-sample or MCMC mode!\n";
+            return 1;
+        }
+
+        const int cache_depth = vm["prefix-cache"].as<int>();
+        if (cache_depth < 0) {
+            cerr << "Error: The prefix cache depth must be non-negative!\n";
+            return 1;
+        }
+
+        if (cache_depth > 0 && (population > 0 || parallel_sample || mcmc_steps > 0 || config_model)) {
+            cerr << "Error: --prefix-cache cannot be combined with population or MCMC mode, --parallel-sample or --config-model!\n";
+            return 1;
+        }
+
+        // Set up adaptive stopping
+
+        const double target_ess = vm.count("target-ess") ? vm["target-ess"].as<double>() : 0;
+        const double target_relerr = vm.count("target-relerr") ? vm["target-relerr"].as<double>() : 0;
+        const double time_budget = vm.count("time-budget") ? parse_duration(vm["time-budget"].as<string>()) : 0;
+
+        vector<Statistic> stats;
+        if (vm.count("stat"))
+            for (const auto &name : vm["stat"].as<vector<string>>())
+                stats.push_back(parse_statistic(name));
+
+        if (target_ess < 0 || target_relerr < 0) {
+            cerr << "Error: Stopping targets must be non-negative!\n";
+            return 1;
+        }
+
+        if (target_relerr > 0 && stats.empty()) {
+            cerr << "Error: A relative error target requires at least one --stat!\n";
+            return 1;
+        }
+
+        // MCMC samples are unweighted but correlated, so the weight-based error estimates do not apply to them.
+        if (mcmc_steps > 0 && (target_ess > 0 || target_relerr > 0 || ! stats.empty())) {
+            cerr << "Error: MCMC mode cannot be combined with --stat or accuracy targets, only with a time budget!\n";
+            return 1;
+        }
+
+        const bool adaptive = target_ess > 0 || target_relerr > 0 || time_budget > 0;
+        if (adaptive && vm["count"].defaulted()) {
+            if (vm.count("npy")) {
+                cerr << "Error: NumPy output with a stopping target requires --count as the maximum number of samples!\n";
+                return 1;
+            }
+            n = numeric_limits<long>::max();
+        }
+
+        // The weights are only valid for whole populations: the resampled members are ordered by their parent,
+        // and a prefix of a population is not a fair sample of it.
+        if (population > 0 && n % population != 0 && n != numeric_limits<long>::max())
+            n += population - n % population;
+
+        // Set up sharding
+
+        const bool sharded = vm.count("shard");
+        ShardInfo shard;
+        if (sharded) {
+            ShardInfo::parse_shard(vm["shard"].as<string>(), shard.index, shard.shards);
+
+            if (! vm.count("seed")) {
+                cerr << "Error: Sharding requires a --seed, which must be the same for all shards!\n";
+                return 1;
+            }
+
+            if (population > 0 || mcmc_steps > 0 || config_model || cache_depth > 0) {
+                cerr << "Error: Sharding cannot be combined with population or MCMC mode, --config-model or --prefix-cache!\n";
+                return 1;
+            }
+
+            // Shards would stop independently, so the merged result would not correspond to a single run.
+            if (adaptive) {
+                cerr << "Error: Sharding cannot be combined with stopping targets!\n";
+                return 1;
+            }
+        }
 
 
         vector<deg_t> degrees;
@@ -96,40 +611,126 @@ int main(int argc, char *argv[]) {
         if (vm.count("seed"))
             rng.seed(vm["seed"].as<long>());
 
-        // Generate samples
+        // Set up vertex processing order
 
-        // Ensure that no precision is lost when printing weight values
-        cout.precision(numeric_limits<double>::max_digits10);
+        Relabelling relabelling(degrees, order, rng);
+        const vector<deg_t> ordered_degrees = relabelling.apply(degrees);
 
-        for (; n > 0; --n) {
-            edgelist_t edges;
-            double logprob;
+        const bool multi = vm["multi"].as<bool>();
+        const bool connected = vm["connected"].as<bool>();
 
-            if (vm["multi"].as<bool>()) {
-                if (vm["connected"].as<bool>()) {
-                    DegreeSequenceMulti ds(degrees.begin(), degrees.end());
-                    tie(edges, logprob) = sample_conn_multi(ds, alpha, rng);
-                } else {
-                    DegreeSequenceMulti ds(degrees.begin(), degrees.end());
-                    tie(edges, logprob) = sample_multi(ds, alpha, rng);
-                }
-            } else {
-                if (vm["connected"].as<bool>()) {
-                    DegreeSequence ds(degrees.begin(), degrees.end());
-                    tie(edges, logprob) = sample_conn(ds, alpha, rng);
-                } else {
-                    DegreeSequence ds(degrees.begin(), degrees.end());
-                    tie(edges, logprob) = sample(ds, alpha, rng);
+        if (sharded) {
+            shard.seed = vm["seed"].as<long>();
+            shard.count = n;
+            shard.vertices = degrees.size();
+            shard.alpha = alpha;
+            shard.connected = connected;
+            shard.multi = multi;
+            shard.order = vm["order"].as<string>();
+            for (const auto &s : stats)
+                shard.stats.push_back(statistic_name(s));
+        }
+
+        // Number of samples written by this process
+        const long output_count = sharded ? shard.shard_count() : n;
+
+        // Set up NumPy output
+
+        // All samples have the same number of edges, so the size of the output is known up front.
+        size_t m = 0;
+        for (const auto &d : degrees)
+            m += d;
+        m /= 2;
+
+        unique_ptr<NpyArray<int32_t>> npy_edges;
+        unique_ptr<NpyArray<int64_t>> npy_offsets;
+        unique_ptr<NpyArray<double>>  npy_logprobs;
+
+        if (vm.count("npy")) {
+            const string prefix = vm["npy"].as<string>();
+            npy_edges.reset(new NpyArray<int32_t>(prefix + "_edges.npy", {output_count*m, 2}));
+            npy_offsets.reset(new NpyArray<int64_t>(prefix + "_offsets.npy", {size_t(output_count)+1}));
+            npy_logprobs.reset(new NpyArray<double>(prefix + "_logprob.npy", {size_t(output_count)}));
+
+            for (long i=0; i <= output_count; ++i)
+                (*npy_offsets)[i] = i*m;
+
+            if (sharded) {
+                ofstream info(prefix + "_shard.txt");
+                info << shard.to_string() << '\n';
+                if (! info) {
+                    cerr << "Error: Could not write " << prefix << "_shard.txt!\n";
+                    return 1;
                 }
             }
+        }
+
+        // Generate samples
 
-            cout << logprob << '\n';
-            for (const auto &edge : edges) {
-                // 'edges' uses 0-based indexing. Increment vertex names to output with 1-based indexing.
-                cout << edge.first+1 << '\t' << edge.second+1 << '\n';
+        const long burn_in = vm.count("mcmc-burn-in") ? vm["mcmc-burn-in"].as<long>() : 10*long(m);
+
+        StoppingRule rule(target_ess, target_relerr, time_budget, stats.size());
+        Observer observer(ordered_degrees, stats, rule);
+
+        // On Ctrl-C, stop generating and write out the samples completed so far.
+        signal(SIGINT, on_interrupt);
+        auto control = interrupt_control();
+
+        unique_ptr<ThreadPool> sample_pool;
+        if (parallel_sample)
+            sample_pool.reset(new ThreadPool(threads));
+
+        // Returns the number of samples generated
+        auto generate_samples = [&] (auto sink_for, auto done) {
+            auto observing_sink_for = [&] (long i) { return make_observing_sink(sink_for(i), observer); };
+            auto observing_done = [&] () { done(); return rule.done() || interrupted; };
+            if (sharded)
+                return generate_shard(ordered_degrees, multi, connected, alpha, n, shard.index, shard.shards, shard.seed, observing_sink_for, observing_done, control, sample_pool.get());
+            else if (cache_depth > 0)
+                return generate_cached(ordered_degrees, multi, connected, alpha, n, cache_depth, rng, observing_sink_for, observing_done);
+            else if (mcmc_steps > 0)
+                return generate_mcmc(ordered_degrees, connected, alpha, n, mcmc_steps, burn_in, mcmc_init, rng, observing_sink_for, observing_done);
+            else
+                return generate_all(ordered_degrees, multi, connected, config_model, alpha, n, population, threads, rng, observing_sink_for, observing_done, control, sample_pool.get());
+        };
+
+        long count;
+        if (npy_edges) {
+            count = generate_samples([&] (long i) { return NpySink(npy_edges->data() + 2*i*m, npy_logprobs->data() + i, relabelling); },
+                                     [] () { });
+
+            if (count < output_count) {
+                npy_edges->shrink({count*m, 2});
+                npy_offsets->shrink({size_t(count)+1});
+                npy_logprobs->shrink({size_t(count)});
+            }
+        } else {
+            // Text output is formatted and written on a separate thread.
+            if (sharded)
+                cout << shard.to_string() << '\n';
+            cout.flush();
+            AsyncTextWriter writer(stdout, relabelling, m);
+
+            count = generate_samples([&] (long) { return AsyncTextWriter::Sink(writer.acquire()); },
+                                     [&] () { writer.publish(); });
+
+            writer.close();
+            if (writer.failed()) {
+                cerr << "Error: Could not write output!\n";
+                return 1;
             }
+        }
+
+        // Report the estimates
+        if (adaptive || ! stats.empty() || sharded) {
+            print_summary(cerr, count, rule, stats);
+            if (rule.has_accuracy_target() && ! rule.accurate() && ! interrupted)
+                cerr << (rule.out_of_time() ? "Time budget" : "Sample count limit") << " reached before meeting the targets.\n";
+        }
 
-            cout << "\n";
+        if (interrupted) {
+            cerr << "Interrupted after " << count << " complete samples.\n";
+            return 130; // the conventional exit status after SIGINT
         }
     }
     catch(exception& e) {
@@ -0,0 +1,1022 @@
+
+#include "Sampler.h"
+#include "ConnSampler.h"
+#include "SamplerMulti.h"
+#include "ConnSamplerMulti.h"
+#include "ReferenceGraphs.h"
+#include "CounterRNG.h"
+#include "PrefixCache.h"
+#include "ThreadPool.h"
+#include "ImplicitSampler.h"
+#include "ConfigurationModel.h"
+#include "LaneSampler.h"
+#include "SmallGraphs.h"
+#include "PopulationSampler.h"
+#include "SampleServer.h"
+
+#include <boost/program_options.hpp>
+#include <boost/math/distributions/chi_squared.hpp>
+#include <random>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <tuple>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace po = boost::program_options;
+using namespace CDS;
+using namespace std;
+
+// Validates the sampling engines in two ways:
+//
+//  1. Lockstep comparison. An engine under test and a reference policy are run side by side on the same
+//     counter-based random stream. The engine under test makes every choice. At each step, the reference
+//     computes its own allowed set for the same state, and the choice and the change in logprob are checked
+//     against it. The samples must also be identical to those of the engine run on its own.
+//     The implicit engine, ImplicitSimpleGraphs, is checked the same way; its samples differ from those of SimpleGraphs.
+//     So are the fixed-size engines, SmallSimpleGraphs, whose logprob must agree exactly, also with floating point weights.
+//     The context weights, e.g. ResidualWeight, are checked in lockstep too, along with the threshold that they see.
+//     Likewise, samples with the scans split across a thread pool must be identical to the serial ones.
+//
+//  2. Enumeration. All realizations of small degree sequences are enumerated, and a chi-square test checks
+//     that the importance-weighted frequencies of the samples are uniform over them. This checks the
+//     distribution and the normalization of logprob: E[exp(-logprob)] is prod_i d_i! for each realization.
+//     For the configuration model, whose logprob is normalized by a predicted acceptance probability, the exact one is used instead.
+//     Samples of a population are not independent, thus population mode is tested on whole populations.
+//
+// The sampling server is also checked for requests being held up by idle connections, and for shutting down promptly.
+
+
+/***** Lockstep comparison *****/
+
+// Thrown when the engine under test and the reference disagree
+class Mismatch : public runtime_error {
+public:
+    explicit Mismatch(const string &what) : runtime_error(what) { }
+};
+
+// True for engines which sum floating point weights in the order of the reference, thus give exactly the same logprob
+template<typename Graphs>
+struct exact_weight_sums : false_type { };
+
+template<int Words>
+struct exact_weight_sums<SmallSimpleGraphs<Words>> : true_type { };
+
+// Graph type policy that runs 'Graphs' and the reference policy 'Reference' side by side.
+// 'Reference' must provide allowed_set(), as ReferenceSimpleGraphs does.
+template<typename Graphs, typename Reference>
+class LockstepGraphs {
+    Graphs graphs;
+    Reference reference;
+    AllowedList reference_allowed;
+
+public:
+
+    template<typename DS>
+    explicit LockstepGraphs(const DS &ds) : graphs(ds), reference(ds) { }
+
+    // For engines which take a different representation of the degree sequence than the reference
+    template<typename DS, typename ReferenceDS>
+    LockstepGraphs(const DS &ds, const ReferenceDS &reference_ds) : graphs(ds), reference(reference_ds) { }
+
+    decltype(auto) degrees() const { return graphs.degrees(); }
+    int size() const { return graphs.size(); }
+    int degree_sum() const { return graphs.degree_sum(); }
+
+    template<typename Connectivity, typename Weight, typename RNG>
+    int choose(int vertex, const Connectivity &conn, const Weight &weight, RNG &rng, double &logprob) {
+        const double before = logprob;
+        const int u = graphs.choose(vertex, conn, weight, rng, logprob);
+
+        auto &weights = reference_allowed.weights(typename Weight::weight_type());
+        auto &allowed = reference_allowed.vertices;
+        allowed.clear();
+        weights.clear();
+        reference.allowed_set(vertex, conn, weight, allowed, weights);
+
+        auto it = find(allowed.begin(), allowed.end(), u);
+        if (it == allowed.end() || weights[it - allowed.begin()] == 0)
+            throw Mismatch("vertex " + to_string(vertex) + " connected to " + to_string(u) + ", which the reference does not allow");
+
+        // Integer weights are summed exactly by both sides, thus the logprob must agree exactly.
+        // Floating point weights may be summed in a different order, see exact_weight_sums.
+        const double expected = before - log(accumulate(weights.begin(), weights.end(), 0.0));
+        // Context weights differ within a degree class, thus the fixed-size engines do not sum them in the same order either.
+        const bool exact = is_integral<typename Weight::weight_type>::value ||
+                           (exact_weight_sums<Graphs>::value && ! is_context_weight<Weight>::value);
+        if (exact ? logprob != expected : abs(logprob - expected) > 1e-12 * max(1.0, abs(expected))) {
+            ostringstream message;
+            message << setprecision(17) << "vertex " << vertex << " connected to " << u
+                    << " with logprob " << logprob << ", the reference gives " << expected;
+            throw Mismatch(message.str());
+        }
+
+        return u;
+    }
+
+    // Used by context weights
+    deg_t step_threshold(int vertex) {
+        const deg_t theta = graphs.step_threshold(vertex);
+        if (theta != reference.step_threshold(vertex))
+            throw Mismatch("the threshold of vertex " + to_string(vertex) + " differs from the reference");
+        return theta;
+    }
+
+    void connect(int vertex, int u) {
+        graphs.connect(vertex, u);
+        reference.connect(vertex, u);
+    }
+
+    void finish_vertex(int vertex, double &logprob) {
+        double reference_logprob = logprob;
+        graphs.finish_vertex(vertex, logprob);
+        reference.finish_vertex(vertex, reference_logprob);
+        if (logprob != reference_logprob)
+            throw Mismatch("the logprob correction after vertex " + to_string(vertex) + " differs from the reference");
+    }
+};
+
+// Run the engine with the given weight policy, or with the one for alpha, see sample_dispatch()
+template<typename Connectivity, typename Graphs, typename Weight, typename RNG, typename Sink>
+void sample_weighted(Graphs graphs, const Weight &weight, RNG &rng, Sink &sink) {
+    sample_engine<Connectivity>(move(graphs), weight, rng, sink);
+}
+
+template<typename Connectivity, typename Graphs, typename RNG, typename Sink>
+void sample_weighted(Graphs graphs, double alpha, RNG &rng, Sink &sink) {
+    sample_dispatch<Connectivity>(move(graphs), alpha, rng, sink);
+}
+
+// Run 'count' samples of the engine 'Graphs' on its own and in lockstep with 'Reference',
+// using the same random streams. Returns an empty string on success, or a description of the first problem.
+// 'Graphs' is constructed from 'ds', and 'Reference' from 'reference_ds'. 'weight' is alpha or a weight policy.
+template<typename Connectivity, typename Graphs, typename Reference, typename DS, typename ReferenceDS, typename Weight>
+string lockstep_test(const DS &ds, const ReferenceDS &reference_ds, const Weight &weight, long count, uint64_t key) {
+    for (long k=0; k < count; ++k) {
+        CounterRNG plain_stream(key, k), lockstep_stream(key, k);
+        EdgeListSink plain_sink, lockstep_sink;
+
+        sample_weighted<Connectivity>(Graphs(ds), weight, plain_stream, plain_sink);
+        try {
+            sample_weighted<Connectivity>(LockstepGraphs<Graphs, Reference>(ds, reference_ds), weight, lockstep_stream, lockstep_sink);
+        } catch (Mismatch &e) {
+            return "sample " + to_string(k) + ": " + e.what();
+        }
+
+        if (plain_sink.result() != lockstep_sink.result())
+            return "sample " + to_string(k) + ": the samples differ when run in lockstep";
+    }
+    return "";
+}
+
+template<typename Connectivity, typename Graphs, typename Reference, typename DS, typename Weight>
+string lockstep_test(const DS &ds, const Weight &weight, long count, uint64_t key) {
+    return lockstep_test<Connectivity, Graphs, Reference>(ds, ds, weight, count, key);
+}
+
+
+// Run 'count' samples of the engine 'Graphs' serially and with every scan split across 'pool',
+// using the same random streams. Returns an empty string on success, or a description of the first problem.
+template<typename Connectivity, typename Graphs, typename DS>
+string parallel_test(const DS &ds, double alpha, long count, uint64_t key, ThreadPool &pool) {
+    for (long k=0; k < count; ++k) {
+        CounterRNG serial_stream(key, k), parallel_stream(key, k);
+        EdgeListSink serial_sink, parallel_sink;
+
+        sample_dispatch<Connectivity>(Graphs(ds), alpha, serial_stream, serial_sink);
+
+        Graphs graphs(ds);
+        graphs.use_thread_pool(pool, 1);
+        sample_dispatch<Connectivity>(move(graphs), alpha, parallel_stream, parallel_sink);
+
+        if (serial_sink.result() != parallel_sink.result())
+            return "sample " + to_string(k) + ": the parallel sample differs from the serial one";
+    }
+    return "";
+}
+
+
+/***** Enumeration *****/
+
+// Sorted edge list with each edge as (smaller, larger). Two edge lists represent
+// the same labelled (multi)graph if and only if their canonical forms are equal.
+edgelist_t canonical(edgelist_t edges) {
+    for (auto &e : edges)
+        if (e.first > e.second)
+            swap(e.first, e.second);
+    sort(edges.begin(), edges.end());
+    return edges;
+}
+
+bool is_connected(int n, const edgelist_t &edges) {
+    vector<int> parent(n);
+    iota(parent.begin(), parent.end(), 0);
+    function<int(int)> root = [&] (int v) { return parent[v] == v ? v : parent[v] = root(parent[v]); };
+
+    int components = n;
+    for (const auto &e : edges) {
+        int a = root(e.first), b = root(e.second);
+        if (a != b) {
+            parent[a] = b;
+            components--;
+        }
+    }
+    return components == 1;
+}
+
+// Find all realizations of the degree sequence 'remaining' by backtracking.
+// The stubs of vertex v are connected to vertices w, w+1, ... before moving on to v+1.
+void enumerate(vector<deg_t> &remaining, int v, int w, bool multi, edgelist_t &edges, vector<edgelist_t> &result) {
+    const int n = remaining.size();
+
+    if (v == n) {
+        result.push_back(canonical(edges));
+        return;
+    }
+    if (remaining[v] == 0) {
+        enumerate(remaining, v+1, v+2, multi, edges, result);
+        return;
+    }
+    if (w >= n)
+        return;
+
+    const int max_multiplicity = min(multi ? remaining[v] : 1, remaining[w]);
+    for (int k=0; k <= max_multiplicity; ++k) {
+        if (k > 0) {
+            remaining[v]--;
+            remaining[w]--;
+            edges.push_back({v, w});
+        }
+        enumerate(remaining, v, w+1, multi, edges, result);
+    }
+    for (int k=0; k < max_multiplicity; ++k) {
+        remaining[v]++;
+        remaining[w]++;
+        edges.pop_back();
+    }
+}
+
+vector<edgelist_t> realizations(vector<deg_t> degrees, bool multi, bool connected) {
+    const int n = degrees.size();
+    vector<edgelist_t> all;
+    edgelist_t edges;
+    enumerate(degrees, 0, 1, multi, edges, all);
+
+    vector<edgelist_t> result;
+    for (auto &g : all)
+        if (! connected || is_connected(n, g))
+            result.push_back(move(g));
+    return result;
+}
+
+// Enumeration tests are only run if there are at least this many samples per realization
+const long min_samples_per_realization = 500;
+
+struct UniformityTest {
+    double chi2;
+    int df;
+    double p;
+    string problem; // non-empty if a sample was not a valid realization, or a realization was never sampled
+};
+
+// Chi-square test of uniformity of the importance-weighted samples over 'graphs'.
+//
+// For a realization g, the importance weight w = exp(-logprob) satisfies E[w 1(sample = g)] = prod_i d_i!.
+// Thus y_g = w 1(sample = g) / prod_i d_i! has mean 1 for every g. Each mean is estimated from the samples
+// along with its standard error, and the squared z-scores are summed over the realizations.
+//
+// Samples which are not independent, the members of a population, are passed in consecutive groups of 'group'.
+// Only the average of y_g over a whole group has mean 1, thus the group averages are used in place of the samples.
+UniformityTest uniformity_test(const vector<deg_t> &degrees, const vector<edgelist_t> &graphs,
+                               const vector<tuple<edgelist_t, double>> &samples, long group = 1)
+{
+    map<edgelist_t, int> index;
+    for (size_t i=0; i < graphs.size(); ++i)
+        index[graphs[i]] = i;
+
+    double log_leaves = 0;
+    for (deg_t d : degrees)
+        log_leaves += logfact(d);
+
+    UniformityTest test{0, int(graphs.size()), 1, ""};
+
+    vector<double> sum(graphs.size()), sum_squares(graphs.size()), group_sum(graphs.size());
+    vector<int> in_group; // realizations with a sample in the current group
+    for (size_t k=0; k < samples.size(); ++k) {
+        auto it = index.find(canonical(get<0>(samples[k])));
+        if (it == index.end()) {
+            test.problem = "a sample is not a valid realization";
+            test.p = 0;
+            return test;
+        }
+        in_group.push_back(it->second);
+        group_sum[it->second] += exp(-get<1>(samples[k]) - log_leaves);
+
+        if ((k + 1) % group == 0) {
+            for (int i : in_group) {
+                double y = group_sum[i] / group;
+                sum[i] += y;
+                sum_squares[i] += y*y;
+                group_sum[i] = 0;
+            }
+            in_group.clear();
+        }
+    }
+
+    const double count = samples.size() / group;
+    for (size_t i=0; i < graphs.size(); ++i) {
+        if (sum[i] == 0) {
+            test.problem = "a realization was never sampled";
+            test.p = 0;
+            return test;
+        }
+        double mean = sum[i] / count;
+        double variance = sum_squares[i] / count - mean*mean;
+        test.chi2 += (mean - 1)*(mean - 1) / max(variance / count, 1e-300);
+    }
+
+    test.p = boost::math::cdf(boost::math::complement(boost::math::chi_squared(test.df), test.chi2));
+    return test;
+}
+
+
+// A sampling method under test: generates 'count' samples of the degree sequence, sample k from CounterRNG(key, k).
+typedef function<vector<tuple<edgelist_t, double>>(const vector<deg_t> &, double, uint64_t, long)> Sampler;
+
+// Sampler calling 'f' for each sample
+template<typename DS>
+Sampler plain_sampler(void (*f)(DS, double, CounterRNG &, EdgeListSink &)) {
+    return [f] (const vector<deg_t> &degrees, double alpha, uint64_t key, long count) {
+        vector<tuple<edgelist_t, double>> samples;
+        samples.reserve(count);
+        for (long k=0; k < count; ++k) {
+            CounterRNG stream(key, k);
+            EdgeListSink sink;
+            f(DS(degrees.begin(), degrees.end()), alpha, stream, sink);
+            samples.push_back(sink.result());
+        }
+        return samples;
+    };
+}
+
+// Sampler using the general engine, SimpleGraphs, which sample() and sample_conn() only use for more than 128 vertices
+template<typename Connectivity>
+Sampler general_sampler() {
+    return [] (const vector<deg_t> &degrees, double alpha, uint64_t key, long count) {
+        vector<tuple<edgelist_t, double>> samples;
+        samples.reserve(count);
+        for (long k=0; k < count; ++k) {
+            CounterRNG stream(key, k);
+            EdgeListSink sink;
+            sample_dispatch<Connectivity>(SimpleGraphs(DegreeSequence(degrees.begin(), degrees.end())), alpha, stream, sink);
+            samples.push_back(sink.result());
+        }
+        return samples;
+    };
+}
+
+// Sampler using the engine with the graph type policy 'Graphs' and the weight policy make_weight(degrees).
+// The alpha of the test is not used.
+template<typename Connectivity, typename Graphs, typename DS, typename MakeWeight>
+Sampler weighted_sampler(MakeWeight make_weight) {
+    return [make_weight] (const vector<deg_t> &degrees, double, uint64_t key, long count) {
+        vector<tuple<edgelist_t, double>> samples;
+        samples.reserve(count);
+        for (long k=0; k < count; ++k) {
+            CounterRNG stream(key, k);
+            EdgeListSink sink;
+            sample_engine<Connectivity>(Graphs(DS(degrees.begin(), degrees.end())), make_weight(degrees), stream, sink);
+            samples.push_back(sink.result());
+        }
+        return samples;
+    };
+}
+
+// Draw 'count' samples from 'cache'
+template<typename Cache>
+vector<tuple<edgelist_t, double>> sample_cached(const Cache &cache, uint64_t key, long count) {
+    vector<tuple<edgelist_t, double>> samples;
+    samples.reserve(count);
+    for (long k=0; k < count; ++k) {
+        CounterRNG stream(key, k);
+        EdgeListSink sink;
+        cache.sample(stream, sink);
+        samples.push_back(sink.result());
+    }
+    return samples;
+}
+
+// Sampler sharing a PrefixCache between all samples. All levels of the decision tree are cached,
+// thus on these small sequences, most choices are served from the cache.
+template<typename Connectivity, typename Graphs, typename DS>
+Sampler cached_sampler() {
+    return [] (const vector<deg_t> &degrees, double alpha, uint64_t key, long count) {
+        Graphs graphs(DS(degrees.begin(), degrees.end()));
+        return prefix_cache_dispatch<Connectivity>(move(graphs), alpha, numeric_limits<int>::max(), size_t(1) << 20, [&] (const auto &cache) {
+            return sample_cached(cache, key, count);
+        });
+    };
+}
+
+// As cached_sampler(), with the weight policy make_weight(degrees). The alpha of the test is not used.
+template<typename Connectivity, typename Graphs, typename DS, typename MakeWeight>
+Sampler weighted_cached_sampler(MakeWeight make_weight) {
+    return [make_weight] (const vector<deg_t> &degrees, double, uint64_t key, long count) {
+        typedef decltype(make_weight(degrees)) Weight;
+        PrefixCache<Connectivity, Graphs, Weight> cache(Graphs(DS(degrees.begin(), degrees.end())), make_weight(degrees),
+                                                        numeric_limits<int>::max(), size_t(1) << 20);
+        return sample_cached(cache, key, count);
+    };
+}
+
+
+// Stores a sample into a given slot
+class SlotSink {
+    tuple<edgelist_t, double> &slot;
+
+public:
+
+    explicit SlotSink(tuple<edgelist_t, double> &slot) : slot(slot) { }
+
+    void edge(int u, int v) { get<0>(slot).push_back({u, v}); }
+    void finish(double logprob) { get<1>(slot) = logprob; }
+};
+
+// Sampler running the samples in the lanes of SmallGraphLanes. They all share one random stream.
+Sampler lane_sampler() {
+    return [] (const vector<deg_t> &degrees, double alpha, uint64_t key, long count) {
+        vector<tuple<edgelist_t, double>> samples(count);
+        CounterRNG stream(key, 0);
+        sample_small(DegreeSequence(degrees.begin(), degrees.end()), alpha, count, stream, [&] (long i) {
+            return SlotSink(samples[i]);
+        });
+        return samples;
+    };
+}
+
+// Sampler for the configuration model with rejection. Its logprob uses the predicted acceptance probability,
+// which is only asymptotically exact; here it is replaced by the exact one, computed from the realizations.
+// A matching is a realization with multiplicities m_ij in prod_i d_i! / prod_ij m_ij! ways, out of (2m-1)!!.
+Sampler configuration_sampler(bool multi) {
+    return [multi] (const vector<deg_t> &degrees, double, uint64_t key, long count) {
+        double log_leaves = 0;
+        long stubs = 0;
+        for (deg_t d : degrees) {
+            log_leaves += logfact(d);
+            stubs += d;
+        }
+
+        double accepted = 0;
+        for (const auto &g : realizations(degrees, multi, false)) {
+            double log_multiplicity = 0;
+            for (size_t i=0, j; i < g.size(); i = j) {
+                for (j = i+1; j < g.size() && g[j] == g[i]; ++j)
+                    ;
+                log_multiplicity += logfact(j - i);
+            }
+            accepted += exp(log_leaves - log_multiplicity - log_matchings(stubs));
+        }
+
+        const double predicted = multi ? loop_free_acceptance(DegreeSequenceMulti(degrees.begin(), degrees.end()))
+                                       : simple_acceptance(DegreeSequence(degrees.begin(), degrees.end()));
+        const double correction = log(predicted) - log(accepted);
+
+        vector<tuple<edgelist_t, double>> samples;
+        samples.reserve(count);
+        for (long k=0; k < count; ++k) {
+            CounterRNG stream(key, k);
+            EdgeListSink sink;
+            NoControl control;
+            if (multi)
+                sample_configuration_multi(DegreeSequenceMulti(degrees.begin(), degrees.end()), stream, sink, control);
+            else
+                sample_configuration(DegreeSequence(degrees.begin(), degrees.end()), stream, sink, control);
+            auto sample = sink.result();
+            get<1>(sample) += correction;
+            samples.push_back(move(sample));
+        }
+        return samples;
+    };
+}
+
+
+// Sampler generating populations of 'size' samples by sequential importance resampling, population p from CounterRNG(key, p).
+// The population is resampled whenever its ESS drops below 'threshold' times its size.
+Sampler population_sampler(bool multi, bool connected, int size, double threshold, ThreadPool &pool) {
+    return [=, &pool] (const vector<deg_t> &degrees, double alpha, uint64_t key, long count) {
+        vector<tuple<edgelist_t, double>> samples;
+        samples.reserve(count);
+        for (long p=0; p < count / size; ++p) {
+            CounterRNG stream(key, p);
+            vector<tuple<edgelist_t, double>> population;
+            if (multi) {
+                const DegreeSequenceMulti ds(degrees.begin(), degrees.end());
+                population = connected ? sample_conn_multi_population(ds, alpha, size, stream, pool, threshold)
+                                       : sample_multi_population(ds, alpha, size, stream, pool, threshold);
+            } else {
+                const DegreeSequence ds(degrees.begin(), degrees.end());
+                population = connected ? sample_conn_population(ds, alpha, size, stream, pool, threshold)
+                                       : sample_population(ds, alpha, size, stream, pool, threshold);
+            }
+            move(population.begin(), population.end(), back_inserter(samples));
+        }
+        return samples;
+    };
+}
+
+
+/***** Sampling server *****/
+
+int connect_socket(const string &path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0) {
+        const string error = strerror(errno);
+        if (fd >= 0)
+            ::close(fd);
+        throw runtime_error("Could not connect to " + path + ": " + error);
+    }
+    return fd;
+}
+
+// Client side of a connection to the server under test
+class ServerClient {
+    int fd;
+    Connection connection;
+
+public:
+
+    explicit ServerClient(const string &path) : fd(connect_socket(path)), connection(fd) { }
+    ~ServerClient() { ::close(fd); }
+
+    void send(const string &payload) {
+        connection.send(payload);
+        connection.flush();
+    }
+
+    // Wait up to 'seconds' for the next message. Returns false if none arrived.
+    bool receive(string &payload, double seconds) {
+        const auto deadline = chrono::steady_clock::now() + chrono::duration<double>(seconds);
+        while (! connection.next_frame(payload)) {
+            const auto left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+            if (left <= 0)
+                return false;
+            pollfd p = {fd, POLLIN, 0};
+            if (::poll(&p, 1, left) > 0 && ! connection.receive())
+                return false;
+        }
+        return true;
+    }
+};
+
+// Run a server with a single worker and more connections than workers. While other connections are idle,
+// a stats request must be answered. Then the worker is blocked by a large sample request from a client that
+// does not read the graphs, and the server must still stop promptly.
+// Returns the problems found by the two checks, as in lockstep_test().
+pair<string, string> server_test() {
+    const string path = "/tmp/cdvalidate-" + to_string(::getpid()) + ".sock";
+    unique_ptr<SampleServer> server(new SampleServer(path, 1));
+    atomic<bool> stop(false);
+    thread loop([&] { server->run([&] { return stop.load(); }, 20); });
+
+    string idle_problem;
+    vector<unique_ptr<ServerClient>> idle;
+    for (int i=0; i < 3; ++i)
+        idle.emplace_back(new ServerClient(path));
+    {
+        ServerClient client(path);
+        client.send(PayloadWriter(ServerProtocol::stats_request).payload());
+        string reply;
+        if (! client.receive(reply, 5) || reply[0] != char(ServerProtocol::stats_message))
+            idle_problem = "no answer to a stats request while other connections were idle";
+    }
+
+    ServerClient stalled(path);
+    PayloadWriter request(ServerProtocol::sample_request);
+    request.u8(ServerProtocol::flag_connected).f64(1).i64(ServerProtocol::max_count).u64(0).u32(2000);
+    for (int i=0; i < 2000; ++i)
+        request.u32(4);
+    stalled.send(request.payload());
+    this_thread::sleep_for(chrono::milliseconds(500)); // until the socket buffer is full
+
+    stop = true;
+    loop.join();
+
+    // A hanging server cannot be recovered from, thus it ends the program
+    const auto start = chrono::steady_clock::now();
+    atomic<bool> stopped(false);
+    thread destroy([&] { server.reset(); stopped = true; });
+    for (int i=0; i < 100 && ! stopped; ++i)
+        this_thread::sleep_for(chrono::milliseconds(100));
+    if (! stopped) {
+        cout << "server\tshutdown\tFAIL: the server did not stop within 10 seconds" << endl;
+        _Exit(1);
+    }
+    destroy.join();
+
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return {idle_problem, seconds > 1 ? "the server took " + to_string(seconds) + " seconds to stop" : ""};
+}
+
+
+/***** Test cases *****/
+
+vector<deg_t> parse_degrees(const string &str) {
+    istringstream in(str);
+    vector<deg_t> degrees;
+    deg_t d;
+    while (in >> d)
+        degrees.push_back(d);
+    return degrees;
+}
+
+// Random graphical sequence with n vertices and degrees between 1 and dmax
+vector<deg_t> random_degrees(int n, int dmax, mt19937 &rng) {
+    uniform_int_distribution<deg_t> dist(1, dmax);
+    while (true) {
+        vector<deg_t> degrees(n);
+        for (auto &d : degrees)
+            d = dist(rng);
+        if (accumulate(degrees.begin(), degrees.end(), 0) % 2 == 1)
+            degrees[0] += degrees[0] > 1 ? -1 : 1;
+        if (DegreeSequence(degrees.begin(), degrees.end()).is_graphical())
+            return degrees;
+    }
+}
+
+// Sequences for the enumeration tests, n <= 9. Those marked 'multi' are used for the multigraph samplers.
+struct EnumerationCase {
+    const char *degrees;
+    bool multi;
+};
+
+const EnumerationCase enumeration_cases[] = {
+    {"1 1 2 2 3 3", false},
+    {"2 2 2 2 2 2", false},
+    {"3 3 3 3 3 3", false},
+    {"4 3 3 2 2 1 1", false},
+    {"5 2 2 2 1 1 1", false},
+    {"6 2 2 2 2 1 1 1 1", false},
+    {"3 3 3 1 1 1 1 1", false},
+    {"4 4 2 2", true},
+    {"3 3 2 2 2", true},
+    {"5 3 3 2 1", true},
+    {"2 2 2 2 2 2", true},
+    {"4 2 2 1 1 1 1", true},
+    {"4 2 2 2 1 1", true},
+};
+
+
+int main(int argc, char *argv[]) {
+
+    try {
+
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("help,h", "produce help message")
+            ("count,n",        po::value<long>()->default_value(200000L),   "number of samples per enumeration test")
+            ("lockstep,l",     po::value<long>()->default_value(200L),      "number of samples per lockstep comparison")
+            ("significance",   po::value<double>()->default_value(1e-5),    "an enumeration test fails if its p-value is below this")
+            ("seed,s",         po::value<unsigned long>()->default_value(42), "set random seed")
+        ;
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help")) {
+            cout << "Usage:\n"
+                 << argv[0] << " [options]\n\n"
+                 << "Validates the samplers against the reference allowed set computation on shared\n"
+                 << "random streams, and against complete enumerations of small degree sequences.\n"
+                 << "The exit status is nonzero if any test fails.\n\n"
+                 << desc << "\n";
+            return 0;
+        }
+
+        const long count = vm["count"].as<long>();
+        const long lockstep_count = vm["lockstep"].as<long>();
+        const double significance = vm["significance"].as<double>();
+
+        mt19937 rng(vm["seed"].as<unsigned long>());
+        const vector<double> alphas = {1, 0, 0.5};
+
+        int failures = 0, tests = 0;
+
+        // Part 1: lockstep comparison of SimpleGraphs against ReferenceSimpleGraphs
+
+        vector<pair<string, vector<deg_t>>> lockstep_sequences;
+        for (const auto &c : enumeration_cases)
+            if (! c.multi)
+                lockstep_sequences.push_back({c.degrees, parse_degrees(c.degrees)});
+        for (int n : {10, 30, 100})
+            for (int dmax : {3, n/3, n-1})
+                lockstep_sequences.push_back({"random n=" + to_string(n) + " dmax=" + to_string(dmax),
+                                              random_degrees(n, dmax, rng)});
+
+        cout << "test\tmode\tsequence\talpha\tsamples\tresult\n";
+
+        for (const auto &sequence : lockstep_sequences)
+            for (bool connected : {false, true})
+                for (double alpha : alphas) {
+                    const vector<deg_t> &degrees = sequence.second;
+                    const DegreeSequence ds(degrees.begin(), degrees.end());
+                    const uint64_t key = uniform_int_distribution<uint64_t>()(rng);
+
+                    string problem;
+                    try {
+                        if (connected)
+                            problem = lockstep_test<EquivClass, SimpleGraphs, ReferenceSimpleGraphs>(ds, alpha, lockstep_count, key);
+                        else
+                            problem = lockstep_test<Unconstrained, SimpleGraphs, ReferenceSimpleGraphs>(ds, alpha, lockstep_count, key);
+                    } catch (invalid_argument &) {
+                        continue; // not potentially connected
+                    }
+
+                    tests++;
+                    if (! problem.empty())
+                        failures++;
+                    cout << "lockstep\t" << (connected ? "simple-conn" : "simple") << '\t'
+                         << sequence.first << '\t' << alpha << '\t' << lockstep_count << '\t'
+                         << (problem.empty() ? "ok" : "FAIL: " + problem) << endl;
+                }
+
+        // Part 1a: lockstep comparison of ImplicitSimpleGraphs against ReferenceSimpleGraphs.
+        // Sorted sequences are added, which are stored as few long runs.
+
+        vector<pair<string, vector<deg_t>>> implicit_sequences = lockstep_sequences;
+        for (int n : {100, 300})
+            for (int dmax : {3, 10}) {
+                vector<deg_t> degrees = random_degrees(n, dmax, rng);
+                sort(degrees.begin(), degrees.end());
+                implicit_sequences.push_back({"sorted n=" + to_string(n) + " dmax=" + to_string(dmax), degrees});
+            }
+
+        for (const auto &sequence : implicit_sequences)
+            for (double alpha : alphas) {
+                const vector<deg_t> &degrees = sequence.second;
+                const ImplicitDegreeSequence ds(degrees.begin(), degrees.end());
+                const DegreeSequence reference_ds(degrees.begin(), degrees.end());
+                const uint64_t key = uniform_int_distribution<uint64_t>()(rng);
+
+                string problem = lockstep_test<Unconstrained, ImplicitSimpleGraphs, ReferenceSimpleGraphs>(ds, reference_ds, alpha, lockstep_count, key);
+
+                tests++;
+                if (! problem.empty())
+                    failures++;
+                cout << "lockstep\tsimple-implicit\t" << sequence.first << '\t' << alpha << '\t' << lockstep_count << '\t'
+                     << (problem.empty() ? "ok" : "FAIL: " + problem) << endl;
+            }
+
+        // Part 1b: lockstep comparison of the fixed-size engines against ReferenceSimpleGraphs, as selected by
+        // with_simple_graphs(), with SmallComponents for connected graphs. Sequences at the size limits are added.
+
+        vector<pair<string, vector<deg_t>>> small_sequences;
+        for (const auto &sequence : lockstep_sequences)
+            if (sequence.second.size() <= size_t(SmallSimpleGraphs<2>::max_vertices))
+                small_sequences.push_back(sequence);
+        for (int n : {64, 65, 128})
+            for (int dmax : {3, n/3})
+                small_sequences.push_back({"random n=" + to_string(n) + " dmax=" + to_string(dmax),
+                                           random_degrees(n, dmax, rng)});
+
+        for (const auto &sequence : small_sequences)
+            for (bool connected : {false, true})
+                for (double alpha : alphas) {
+                    const vector<deg_t> &degrees = sequence.second;
+                    const DegreeSequence ds(degrees.begin(), degrees.end());
+                    const uint64_t key = uniform_int_distribution<uint64_t>()(rng);
+
+                    auto test = [&] (auto graphs, auto connectivity) {
+                        return lockstep_test<typename decltype(connectivity)::type, decltype(graphs), ReferenceSimpleGraphs>(ds, alpha, lockstep_count, key);
+                    };
+
+                    string problem;
+                    try {
+                        problem = connected ? with_simple_graphs<EquivClass>(ds, test) : with_simple_graphs<Unconstrained>(ds, test);
+                    } catch (invalid_argument &) {
+                        continue; // not potentially connected
+                    }
+
+                    tests++;
+                    if (! problem.empty())
+                        failures++;
+                    cout << "lockstep\t" << (connected ? "simple-conn-small" : "simple-small") << '\t'
+                         << sequence.first << '\t' << alpha << '\t' << lockstep_count << '\t'
+                         << (problem.empty() ? "ok" : "FAIL: " + problem) << endl;
+                }
+
+        // Part 1c: parallel scans must not change the samples
+
+        ThreadPool pool(4);
+
+        vector<pair<string, vector<deg_t>>> parallel_sequences = lockstep_sequences;
+        for (const auto &c : enumeration_cases)
+            if (c.multi)
+                parallel_sequences.push_back({c.degrees, parse_degrees(c.degrees)});
+
+        for (const auto &sequence : parallel_sequences)
+            for (bool multi : {false, true})
+                for (bool connected : {false, true})
+                    for (double alpha : alphas) {
+                        const vector<deg_t> &degrees = sequence.second;
+                        const uint64_t key = uniform_int_distribution<uint64_t>()(rng);
+
+                        string problem;
+                        try {
+                            if (multi) {
+                                const DegreeSequenceMulti ds(degrees.begin(), degrees.end());
+                                if (connected)
+                                    problem = parallel_test<EquivClass, MultiGraphs>(ds, alpha, lockstep_count, key, pool);
+                                else
+                                    problem = parallel_test<Unconstrained, MultiGraphs>(ds, alpha, lockstep_count, key, pool);
+                            } else {
+                                const DegreeSequence ds(degrees.begin(), degrees.end());
+                                if (connected)
+                                    problem = parallel_test<EquivClass, SimpleGraphs>(ds, alpha, lockstep_count, key, pool);
+                                else
+                                    problem = parallel_test<Unconstrained, SimpleGraphs>(ds, alpha, lockstep_count, key, pool);
+                            }
+                        } catch (invalid_argument &) {
+                            continue; // not graphical or not potentially connected
+                        }
+
+                        tests++;
+                        if (! problem.empty())
+                            failures++;
+                        cout << "parallel	" << (multi ? "multi" : "simple") << (connected ? "-conn" : "") << '\t'
+                             << sequence.first << '\t' << alpha << '\t' << lockstep_count << '\t'
+                             << (problem.empty() ? "ok" : "FAIL: " + problem) << endl;
+                    }
+
+        // Part 1d: lockstep comparison of the context weights, with SimpleGraphs and with the fixed-size engines
+
+        auto residual = [] (const vector<deg_t> &degrees) { return ResidualWeight(degrees); };
+        auto component = [] (const vector<deg_t> &) { return ComponentWeight(-1); };
+        auto slack = [] (const vector<deg_t> &) { return SlackWeight(1); };
+
+        for (const auto &sequence : small_sequences)
+            for (bool connected : {false, true})
+                for (bool small : {false, true}) {
+                    const vector<deg_t> &degrees = sequence.second;
+                    const DegreeSequence ds(degrees.begin(), degrees.end());
+
+                    auto test_weight = [&] (const string &name, const auto &weight) {
+                        const uint64_t key = uniform_int_distribution<uint64_t>()(rng);
+
+                        auto test = [&] (auto graphs, auto connectivity) {
+                            return lockstep_test<typename decltype(connectivity)::type, decltype(graphs), ReferenceSimpleGraphs>(ds, weight, lockstep_count, key);
+                        };
+
+                        string problem;
+                        try {
+                            if (small)
+                                problem = connected ? with_simple_graphs<EquivClass>(ds, test) : with_simple_graphs<Unconstrained>(ds, test);
+                            else
+                                problem = connected ? test(SimpleGraphs(ds), PolicyTag<EquivClass>()) : test(SimpleGraphs(ds), PolicyTag<Unconstrained>());
+                        } catch (invalid_argument &) {
+                            return; // not potentially connected
+                        }
+
+                        tests++;
+                        if (! problem.empty())
+                            failures++;
+                        cout << "lockstep\t" << (connected ? "simple-conn" : "simple") << (small ? "-small-" : "-") << name << '\t'
+                             << sequence.first << "\t-\t" << lockstep_count << '\t'
+                             << (problem.empty() ? "ok" : "FAIL: " + problem) << endl;
+                    };
+
+                    test_weight("residual", residual(degrees));
+                    test_weight("component", component(degrees));
+                    test_weight("slack", slack(degrees));
+                }
+
+        // Part 2: enumeration tests of the sampling functions
+
+        struct Mode {
+            string name;
+            bool multi, connected;
+            Sampler sampler;
+            bool uses_alpha = true; // false for the modes with a fixed weight policy, which are run once
+            long group = 1;         // the population size, for population mode
+        };
+        const int population = 16;
+        const vector<Mode> modes = {
+            {"simple",               false, false, plain_sampler(sample<CounterRNG, EdgeListSink>)},
+            {"simple-conn",          false, true,  plain_sampler(sample_conn<CounterRNG, EdgeListSink>)},
+            {"simple-general",       false, false, general_sampler<Unconstrained>()},
+            {"simple-conn-general",  false, true,  general_sampler<EquivClass>()},
+            {"simple-reference",     false, false, plain_sampler(sample_reference<CounterRNG, EdgeListSink>)},
+            {"simple-conn-reference",false, true,  plain_sampler(sample_conn_reference<CounterRNG, EdgeListSink>)},
+            {"simple-implicit",      false, false, plain_sampler(sample_implicit<CounterRNG, EdgeListSink>)},
+            {"simple-lanes",         false, false, lane_sampler()},
+            {"simple-config",        false, false, configuration_sampler(false)},
+            {"simple-cached",        false, false, cached_sampler<Unconstrained, SimpleGraphs, DegreeSequence>()},
+            {"simple-conn-cached",   false, true,  cached_sampler<EquivClass, SimpleGraphs, DegreeSequence>()},
+            {"multi",                true,  false, plain_sampler(sample_multi<CounterRNG, EdgeListSink>)},
+            {"multi-conn",           true,  true,  plain_sampler(sample_conn_multi<CounterRNG, EdgeListSink>)},
+            {"multi-config",         true,  false, configuration_sampler(true)},
+            {"multi-cached",         true,  false, cached_sampler<Unconstrained, MultiGraphs, DegreeSequenceMulti>()},
+            {"multi-conn-cached",    true,  true,  cached_sampler<EquivClass, MultiGraphs, DegreeSequenceMulti>()},
+
+            {"simple-residual",               false, false, weighted_sampler<Unconstrained, SmallSimpleGraphs<1>, DegreeSequence>(residual), false},
+            {"simple-conn-residual",          false, true,  weighted_sampler<SmallComponents<1>, SmallSimpleGraphs<1>, DegreeSequence>(residual), false},
+            {"simple-general-residual",       false, false, weighted_sampler<Unconstrained, SimpleGraphs, DegreeSequence>(residual), false},
+            {"simple-conn-component",         false, true,  weighted_sampler<SmallComponents<1>, SmallSimpleGraphs<1>, DegreeSequence>(component), false},
+            {"simple-conn-general-component", false, true,  weighted_sampler<EquivClass, SimpleGraphs, DegreeSequence>(component), false},
+            {"simple-conn-cached-component",  false, true,  weighted_cached_sampler<EquivClass, SimpleGraphs, DegreeSequence>(component), false},
+            {"simple-slack",                  false, false, weighted_sampler<Unconstrained, SmallSimpleGraphs<1>, DegreeSequence>(slack), false},
+            {"simple-general-slack",          false, false, weighted_sampler<Unconstrained, SimpleGraphs, DegreeSequence>(slack), false},
+            {"simple-conn-general-slack",     false, true,  weighted_sampler<EquivClass, SimpleGraphs, DegreeSequence>(slack), false},
+            {"multi-residual",                true,  false, weighted_sampler<Unconstrained, MultiGraphs, DegreeSequenceMulti>(residual), false},
+            {"multi-conn-component",          true,  true,  weighted_sampler<EquivClass, MultiGraphs, DegreeSequenceMulti>(component), false},
+            {"multi-slack",                   true,  false, weighted_sampler<Unconstrained, MultiGraphs, DegreeSequenceMulti>(slack), false},
+
+            // The default threshold of cdsample, and resampling after almost every vertex
+            {"simple-population",             false, false, population_sampler(false, false, population, 0.5, pool), true, population},
+            {"simple-conn-population",        false, true,  population_sampler(false, true,  population, 0.5, pool), true, population},
+            {"simple-conn-population-always", false, true,  population_sampler(false, true,  population, 1,   pool), true, population},
+            {"multi-population",              true,  false, population_sampler(true,  false, population, 0.5, pool), true, population},
+            {"multi-conn-population-always",  true,  true,  population_sampler(true,  true,  population, 1,   pool), true, population},
+        };
+
+        cout << "\ntest\tmode\tsequence\talpha\trealizations\tsamples\tchi2\tp\tresult\n";
+
+        for (const auto &c : enumeration_cases) {
+            const vector<deg_t> degrees = parse_degrees(c.degrees);
+
+            for (const auto &mode : modes) {
+                if (mode.multi != c.multi)
+                    continue;
+
+                const vector<edgelist_t> graphs = realizations(degrees, mode.multi, mode.connected);
+                if (graphs.empty())
+                    continue;
+
+                // The importance weights are heavy-tailed, thus the standard errors are unreliable unless each realization is sampled many times
+                if (count < min_samples_per_realization * long(graphs.size())) {
+                    cout << "enumeration\t" << mode.name << '\t' << c.degrees << "\t\t" << graphs.size() << '\t'
+                         << count << "\t\t\tskipped, too few samples" << endl;
+                    continue;
+                }
+
+                for (double alpha : mode.uses_alpha ? alphas : vector<double>{1}) {
+                    const uint64_t key = uniform_int_distribution<uint64_t>()(rng);
+
+                    vector<tuple<edgelist_t, double>> samples = mode.sampler(degrees, alpha, key, count);
+
+                    UniformityTest test = uniformity_test(degrees, graphs, samples, mode.group);
+                    bool ok = test.problem.empty() && test.p >= significance;
+
+                    tests++;
+                    if (! ok)
+                        failures++;
+                    ostringstream alpha_column;
+                    if (mode.uses_alpha)
+                        alpha_column << alpha;
+                    else
+                        alpha_column << '-';
+
+                    cout << "enumeration\t" << mode.name << '\t' << c.degrees << '\t' << alpha_column.str() << '\t'
+                         << graphs.size() << '\t' << count << '\t'
+                         << setprecision(4) << test.chi2 << '\t' << test.p << setprecision(6) << '\t'
+                         << (ok ? "ok" : "FAIL" + (test.problem.empty() ? string() : ": " + test.problem)) << endl;
+                }
+            }
+        }
+
+        // Part 3: the sampling server
+
+        cout << "\ntest\tcheck\tresult\n";
+
+        const pair<string, string> server_problems = server_test();
+        for (const auto &check : {make_pair("idle-connections", server_problems.first), make_pair("shutdown", server_problems.second)}) {
+            tests++;
+            if (! check.second.empty())
+                failures++;
+            cout << "server\t" << check.first << '\t' << (check.second.empty() ? "ok" : "FAIL: " + check.second) << endl;
+        }
+
+        cout << "\n" << tests - failures << " of " << tests << " tests passed.\n";
+
+        return failures == 0 ? 0 : 1;
+    }
+    catch(exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,237 @@
+
+#include "Sampler.h"
+#include "ConnSampler.h"
+#include "SamplerMulti.h"
+#include "ConnSamplerMulti.h"
+#include "CounterRNG.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <random>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <cstdint>
+
+namespace py = pybind11;
+using namespace CDS;
+
+static_assert(sizeof(edge) == 2*sizeof(int), "Edges must be laid out as two consecutive ints.");
+
+// Writes a sample directly into the output buffers of a batch.
+class BufferSink {
+    int32_t *edge_out;
+    double *logprob_out;
+
+public:
+
+    BufferSink(int32_t *edge_out, double *logprob_out) : edge_out(edge_out), logprob_out(logprob_out) { }
+
+    void edge(int u, int v) {
+        *edge_out++ = u;
+        *edge_out++ = v;
+    }
+
+    void finish(double logprob) { *logprob_out = logprob; }
+};
+
+// Transfer ownership of an edge list to a NumPy array of shape (m, 2) without copying.
+static py::array_t<int> edges_to_array(edgelist_t &&edges) {
+    auto owner = new edgelist_t(std::move(edges));
+    py::capsule free_when_done(owner, [] (void *p) { delete static_cast<edgelist_t *>(p); });
+    return py::array_t<int>(
+                {owner->size(), size_t(2)},
+                {sizeof(edge), sizeof(int)},
+                reinterpret_cast<const int *>(owner->data()),
+                free_when_done
+           );
+}
+
+
+class ConnectedGraphSampler {
+
+    std::mt19937 rng;
+
+    std::vector<deg_t> degseq;
+    std::unique_ptr<DegreeSequence> ds;        // null if some degree is not less than the vertex count
+    std::unique_ptr<DegreeSequenceMulti> dsm;
+
+    const DegreeSequence &simple_ds() const {
+        if (! ds)
+            throw std::invalid_argument("The degree sequence is not graphical.");
+        return *ds;
+    }
+
+    // Generate 'count' samples using 'threads' threads, with the GIL released.
+    // Sample i uses stream i of a counter-based RNG, so the result does not depend on the number of threads.
+    // The output uses the same layout as the --npy output of cdsample: concatenated edges, offsets, logprobs.
+    template<typename DS, typename Fun>
+    py::tuple sample_batch_impl(const DS &ds, Fun fun, long count, int threads) {
+        if (count < 0)
+            throw std::invalid_argument("The sample count must be non-negative.");
+
+        size_t m = 0;
+        for (const auto &d : degseq)
+            m += d;
+        m /= 2;
+
+        py::array_t<int32_t> edges({count*m, size_t(2)});
+        py::array_t<int64_t> offsets(count+1);
+        py::array_t<double> logprobs(count);
+
+        int32_t *edge_data    = edges.mutable_data();
+        int64_t *offset_data  = offsets.mutable_data();
+        double  *logprob_data = logprobs.mutable_data();
+
+        // Two statements, so that the order of the draws is fixed
+        const uint64_t key_high = rng();
+        const uint64_t key_low = rng();
+        const uint64_t key = (key_high << 32) | key_low;
+
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        if (threads > count)
+            threads = std::max(1L, count);
+
+        {
+            py::gil_scoped_release release;
+
+            std::atomic<long> next(0);
+            std::exception_ptr error;
+            std::mutex error_mutex;
+
+            auto worker = [&] () {
+                try {
+                    for (long i = next++; i < count; i = next++) {
+                        CounterRNG stream(key, i);
+                        BufferSink sink(edge_data + 2*i*m, logprob_data + i);
+                        fun(ds, stream, sink);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (! error)
+                        error = std::current_exception();
+                    next = count; // stop all workers
+                }
+            };
+
+            std::vector<std::thread> pool;
+            for (int t=1; t < threads; ++t)
+                pool.emplace_back(worker);
+            worker();
+            for (auto &th : pool)
+                th.join();
+
+            if (error)
+                std::rethrow_exception(error);
+
+            for (long i=0; i <= count; ++i)
+                offset_data[i] = i*m;
+        }
+
+        return py::make_tuple(edges, offsets, logprobs);
+    }
+
+public:
+
+    ConnectedGraphSampler() :
+        rng{std::random_device{}()},
+        ds(new DegreeSequence),
+        dsm(new DegreeSequenceMulti)
+    { }
+
+    void seed(unsigned long s) { rng.seed(s); }
+
+    void set_degrees(const std::vector<deg_t> &degrees) {
+        std::unique_ptr<DegreeSequenceMulti> new_dsm(new DegreeSequenceMulti(degrees.begin(), degrees.end()));
+
+        std::unique_ptr<DegreeSequence> new_ds;
+        try {
+            new_ds.reset(new DegreeSequence(degrees.begin(), degrees.end()));
+        } catch (const std::invalid_argument &) {
+            // Too large degrees; the sequence may still be multigraphical.
+        }
+
+        degseq = degrees;
+        ds = std::move(new_ds);
+        dsm = std::move(new_dsm);
+    }
+
+    const std::vector<deg_t> &degrees() const { return degseq; }
+
+    bool is_graphical() const { return ds && ds->is_graphical(); }
+    bool is_multigraphical() const { return dsm->is_multigraphical(); }
+
+    py::tuple sample(double alpha) {
+        edgelist_t edges; double logprob;
+        std::tie(edges, logprob) = CDS::sample(simple_ds(), alpha, rng);
+        return py::make_tuple(edges_to_array(std::move(edges)), logprob);
+    }
+
+    py::tuple sample_conn(double alpha) {
+        edgelist_t edges; double logprob;
+        std::tie(edges, logprob) = CDS::sample_conn(simple_ds(), alpha, rng);
+        return py::make_tuple(edges_to_array(std::move(edges)), logprob);
+    }
+
+    py::tuple sample_multi(double alpha) {
+        edgelist_t edges; double logprob;
+        std::tie(edges, logprob) = CDS::sample_multi(*dsm, alpha, rng);
+        return py::make_tuple(edges_to_array(std::move(edges)), logprob);
+    }
+
+    py::tuple sample_conn_multi(double alpha) {
+        edgelist_t edges; double logprob;
+        std::tie(edges, logprob) = CDS::sample_conn_multi(*dsm, alpha, rng);
+        return py::make_tuple(edges_to_array(std::move(edges)), logprob);
+    }
+
+    py::tuple sample_batch(long count, double alpha, bool connected, bool multi, int threads) {
+        if (multi) {
+            if (connected)
+                return sample_batch_impl(*dsm, [alpha] (const DegreeSequenceMulti &ds, CounterRNG &rng, BufferSink &sink) { CDS::sample_conn_multi(ds, alpha, rng, sink); }, count, threads);
+            else
+                return sample_batch_impl(*dsm, [alpha] (const DegreeSequenceMulti &ds, CounterRNG &rng, BufferSink &sink) { CDS::sample_multi(ds, alpha, rng, sink); }, count, threads);
+        } else {
+            if (connected)
+                return sample_batch_impl(simple_ds(), [alpha] (const DegreeSequence &ds, CounterRNG &rng, BufferSink &sink) { CDS::sample_conn(ds, alpha, rng, sink); }, count, threads);
+            else
+                return sample_batch_impl(simple_ds(), [alpha] (const DegreeSequence &ds, CounterRNG &rng, BufferSink &sink) { CDS::sample(ds, alpha, rng, sink); }, count, threads);
+        }
+    }
+};
+
+
+PYBIND11_MODULE(connected_graph_sampler, m) {
+    m.doc() = "Sampling of connected graphs with given degrees, https://arxiv.org/abs/2009.03747";
+
+    py::class_<ConnectedGraphSampler>(m, "ConnectedGraphSampler")
+        .def(py::init<>())
+        .def("set_degrees", &ConnectedGraphSampler::set_degrees, py::arg("degrees"),
+             "Set the degree sequence to sample from.")
+        .def("degrees", &ConnectedGraphSampler::degrees,
+             "The current degree sequence.")
+        .def("seed", &ConnectedGraphSampler::seed, py::arg("seed"),
+             "Seed the random number generator.")
+        .def("is_graphical", &ConnectedGraphSampler::is_graphical,
+             "Test if the degrees are realized by a simple graph.")
+        .def("is_multigraphical", &ConnectedGraphSampler::is_multigraphical,
+             "Test if the degrees are realized by a loop-free multigraph.")
+        .def("sample", &ConnectedGraphSampler::sample, py::arg("alpha") = 1.0,
+             "Sample a simple graph. Returns (edges, logprob).")
+        .def("sample_conn", &ConnectedGraphSampler::sample_conn, py::arg("alpha") = 1.0,
+             "Sample a connected simple graph. Returns (edges, logprob).")
+        .def("sample_multi", &ConnectedGraphSampler::sample_multi, py::arg("alpha") = 1.0,
+             "Sample a loop-free multigraph. Returns (edges, logprob).")
+        .def("sample_conn_multi", &ConnectedGraphSampler::sample_conn_multi, py::arg("alpha") = 1.0,
+             "Sample a connected loop-free multigraph. Returns (edges, logprob).")
+        .def("sample_batch", &ConnectedGraphSampler::sample_batch,
+             py::arg("count"), py::arg("alpha") = 1.0, py::arg("connected") = false, py::arg("multi") = false, py::arg("threads") = 0,
+             "Generate many samples in parallel, without holding the GIL. Returns (edges, offsets, logprobs), "
+             "where the edges of sample i are edges[offsets[i]:offsets[i+1]]. threads=0 uses all available cores.")
+    ;
+}
@@ -0,0 +1,54 @@
+#ifndef CDS_AUTOCORRELATION_H
+#define CDS_AUTOCORRELATION_H
+
+#include <vector>
+#include <numeric>
+#include <cmath>
+#include <limits>
+
+namespace CDS {
+
+// Autocorrelation diagnostics for a scalar statistic recorded along a Markov chain.
+// Sokal, Monte Carlo Methods in Statistical Mechanics: Foundations and New Algorithms (1997)
+
+// Normalized autocorrelation of the series 'x' at the given lag.
+// Returns NaN if the series is constant.
+inline double autocorrelation(const std::vector<double> &x, int lag) {
+    const int n = x.size();
+    if (lag >= n)
+        return std::numeric_limits<double>::quiet_NaN();
+
+    double mean = std::accumulate(x.begin(), x.end(), 0.0) / n;
+
+    double c0 = 0, ct = 0;
+    for (int i=0; i < n; ++i)
+        c0 += (x[i] - mean)*(x[i] - mean);
+    for (int i=0; i+lag < n; ++i)
+        ct += (x[i] - mean)*(x[i+lag] - mean);
+
+    if (c0 == 0)
+        return std::numeric_limits<double>::quiet_NaN();
+    return ct / c0;
+}
+
+// Integrated autocorrelation time, tau = 1 + 2 sum_{t=1}^{M} rho(t), in units of the sampling interval.
+// The window M is chosen automatically as the smallest M with M >= c tau(M).
+// The effective number of independent samples is approximately n / tau.
+// Returns NaN if the series is constant.
+inline double integrated_autocorrelation_time(const std::vector<double> &x, double c = 5) {
+    const int n = x.size();
+    double tau = 1;
+    for (int lag=1; lag < n; ++lag) {
+        double rho = autocorrelation(x, lag);
+        if (std::isnan(rho))
+            return rho;
+        tau += 2*rho;
+        if (lag >= c*tau)
+            break;
+    }
+    return tau;
+}
+
+} // namespace CDS
+
+#endif // CDS_AUTOCORRELATION_H
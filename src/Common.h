@@ -1,7 +1,10 @@
 #ifndef CDS_COMMON_H
 #define CDS_COMMON_H
 
+#include "HugePageAllocator.h"
+
 #include <vector>
+#include <algorithm>
 #include <cmath>
 
 #ifndef Assert
@@ -16,7 +19,34 @@ typedef int deg_t;
 typedef std::pair<int, int> edge;
 typedef std::vector<edge> edgelist_t;
 
-typedef std::vector<char> bitmask_t;
+// Vector type for per-vertex data, which may be backed by huge pages for very large graphs.
+template<typename T>
+using vertex_vector = std::vector<T, HugePageAllocator<T>>;
+
+
+// Set of vertices that can be cleared in O(1), e.g. the vertices that the current vertex may not connect to.
+// Each vertex stores the epoch in which it was last inserted, thus clearing the set is O(1).
+class ExclusionSet {
+    vertex_vector<unsigned> stamp;
+    unsigned epoch;
+
+public:
+
+    explicit ExclusionSet(int n) : stamp(n, 0), epoch(1) { }
+
+    bool operator [] (int v) const { return stamp[v] == epoch; }
+
+    void insert(int v) { stamp[v] = epoch; }
+
+    void erase(int v) { stamp[v] = 0; }
+
+    void clear() {
+        if (++epoch == 0) { // wrapped around, stale stamps must be erased
+            std::fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+    }
+};
 
 
 template<typename T>
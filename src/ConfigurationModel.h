@@ -0,0 +1,228 @@
+#ifndef CDS_CONFIGURATION_MODEL_H
+#define CDS_CONFIGURATION_MODEL_H
+
+#include "Common.h"
+#include "DegreeSequence.h"
+#include "DegreeSequenceMulti.h"
+#include "FenwickTree.h"
+#include "SampleControl.h"
+#include "Sampler.h"
+#include "SamplerMulti.h"
+
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <cmath>
+
+namespace CDS {
+
+// The configuration model with rejection, for sparse degree sequences.
+//
+// The stubs of all vertices are matched uniformly at random. Every simple graph arises from exactly prod_i d_i!
+// matchings, thus rejecting matchings with loops or multi-edges gives exactly uniform simple graphs. A loop-free
+// multigraph with edge multiplicities m_ij arises from prod_i d_i! / prod_ij m_ij! matchings, thus rejecting
+// matchings with loops gives loop-free multigraphs with probability proportional to 1 / prod_ij m_ij!.
+//
+// The stubs are matched in vertex order, like the sequential sampler connects vertices, and a matching is
+// rejected as soon as a loop or multi-edge appears, so most rejected attempts are cheap. Each attempt takes
+// O(m log n) time. For sequences with a small second moment, the acceptance probability is high, and this is
+// faster than the sequential sampler. It is predicted from lambda = sum_i d_i (d_i - 1) / sum_i d_i:
+// exp(-lambda/2 - lambda^2/4) for simple graphs, and exp(-lambda/2) for loop-free multigraphs.
+// These are the limits for large sparse sequences, see Janson, Combin. Probab. Comput. 18 (2009) 205.
+//
+// The logprob follows the convention of the other samplers, E[exp(-logprob) 1(sample = g)] = prod_i d_i!,
+// with the exact acceptance probability replaced by the prediction: for simple graphs, it is the same for all
+// samples, thus the relative weights are exact, and the estimate of the number of graphs from their sum is
+// approximate. For multigraphs, it includes the correction by prod_ij m_ij!, as with sample_multi().
+
+// The predicted probability that a uniform random stub matching is a simple graph
+inline double simple_acceptance(const DegreeSequence &ds) {
+    double sum = 0, sum_pairs = 0;
+    for (int v=0; v < ds.size(); ++v) {
+        sum += ds[v];
+        sum_pairs += double(ds[v]) * (ds[v] - 1);
+    }
+    const double lambda = sum > 0 ? sum_pairs / sum : 0;
+    return std::exp(-lambda/2 - lambda*lambda/4);
+}
+
+// The predicted probability that a uniform random stub matching has no loops
+inline double loop_free_acceptance(const DegreeSequenceMulti &ds) {
+    double sum = 0, sum_pairs = 0;
+    for (int v=0; v < ds.size(); ++v) {
+        sum += ds[v];
+        sum_pairs += double(ds[v]) * (ds[v] - 1);
+    }
+    const double lambda = sum > 0 ? sum_pairs / sum : 0;
+    return std::exp(-lambda/2);
+}
+
+// Use the configuration model when the predicted acceptance probability is at least this
+const double configuration_min_acceptance = 0.1;
+
+
+// One attempt at a uniform random stub matching. Vertices are processed in order; each remaining stub of
+// the current vertex is matched to a uniformly chosen other unmatched stub.
+class StubMatching {
+    vector<deg_t> degrees;
+    vector<deg_t> remaining;       // the number of unmatched stubs of each vertex
+    FenwickTree<long> unmatched;   // the same, for choosing a stub uniformly
+    long stubs;                    // total number of unmatched stubs
+
+    ExclusionSet neighbours;       // neighbours of the current vertex, for simple graphs
+    vector<int> multiplicity;      // multiplicities of the current vertex's edges, for multigraphs
+    vector<int> neighbour_list;
+
+public:
+
+    edgelist_t edges;
+    double log_multiplicity;       // sum of log m_ij! over the edges, for multigraphs
+
+    explicit StubMatching(vector<deg_t> degrees_) :
+        degrees(std::move(degrees_)),
+        neighbours(degrees.size()),
+        multiplicity(degrees.size()),
+        log_multiplicity(0)
+    { }
+
+    // Generate a matching. Returns false as soon as a loop, or with 'simple' set, a multi-edge appears.
+    template<typename RNG, typename Control>
+    bool attempt(bool simple, RNG &rng, Control &control) {
+        const int n = degrees.size();
+
+        remaining = degrees;
+        unmatched = FenwickTree<long>(remaining);
+        stubs = 0;
+        for (const auto &d : degrees)
+            stubs += d;
+
+        edges.clear();
+        log_multiplicity = 0;
+
+        for (int u=0; u < n; ++u) {
+            neighbours.clear();
+
+            while (remaining[u] > 0) {
+                // Take a stub of u, and match it to any other unmatched stub
+                remaining[u]--;
+                unmatched.add(u, -1);
+                stubs--;
+
+                const int v = unmatched.find(std::uniform_int_distribution<long>(0, stubs-1)(rng));
+                if (v == u || (simple && neighbours[v])) {
+                    for (const auto &w : neighbour_list)
+                        multiplicity[w] = 0;
+                    neighbour_list.clear();
+                    return false;
+                }
+
+                remaining[v]--;
+                unmatched.add(v, -1);
+                stubs--;
+
+                edges.push_back({u, v});
+                if (simple)
+                    neighbours.insert(v);
+                else if (multiplicity[v]++ == 0)
+                    neighbour_list.push_back(v);
+
+                control.poll(edges.size(), u);
+            }
+
+            for (const auto &w : neighbour_list) {
+                if (multiplicity[w] > 1)
+                    log_multiplicity += logfact(multiplicity[w]);
+                multiplicity[w] = 0;
+            }
+            neighbour_list.clear();
+        }
+
+        return true;
+    }
+};
+
+// log (2m-1)!!, the log of the number of matchings of 2m stubs
+inline double log_matchings(long stubs) {
+    const long m = stubs / 2;
+    return logfact(stubs) - m*std::log(2.0) - logfact(m);
+}
+
+// Uniform simple graphs from the configuration model with rejection, passing the edges to 'sink' once a matching is accepted.
+// 'control' is polled as stubs are matched. Throws std::invalid_argument if the sequence is not graphical.
+template<typename RNG, typename Sink, typename Control>
+void sample_configuration(const DegreeSequence &ds, RNG &rng, Sink &sink, Control &control) {
+    if (! ds.is_graphical())
+        throw std::invalid_argument("The degree sequence is not graphical.");
+
+    control.start();
+
+    StubMatching matching(ds.degrees());
+    while (! matching.attempt(true, rng, control))
+        ;
+
+    for (const auto &e : matching.edges)
+        sink.edge(e.first, e.second);
+
+    sink.finish(-log_matchings(2*matching.edges.size()) - std::log(simple_acceptance(ds)));
+}
+
+// Loop-free multigraphs from the configuration model with rejection, passing the edges to 'sink' once a matching is accepted.
+// 'control' is polled as stubs are matched. Throws std::invalid_argument if the sequence is not multigraphical.
+template<typename RNG, typename Sink, typename Control>
+void sample_configuration_multi(const DegreeSequenceMulti &ds, RNG &rng, Sink &sink, Control &control) {
+    if (! ds.is_multigraphical())
+        throw std::invalid_argument("The degree sequence is not multigraphical.");
+
+    control.start();
+
+    vector<deg_t> degrees(ds.size());
+    for (int v=0; v < ds.size(); ++v)
+        degrees[v] = ds[v];
+
+    StubMatching matching(std::move(degrees));
+    while (! matching.attempt(false, rng, control))
+        ;
+
+    for (const auto &e : matching.edges)
+        sink.edge(e.first, e.second);
+
+    sink.finish(-log_matchings(2*matching.edges.size()) - std::log(loop_free_acceptance(ds)) - matching.log_multiplicity);
+}
+
+
+// Sample simple graphs using the configuration model with rejection if the predicted acceptance probability
+// is at least configuration_min_acceptance, and sample() otherwise. 'alpha' is only used by sample().
+// The choice depends only on the degree sequence, thus all samples of a sequence come from the same method.
+template<typename RNG, typename Sink, typename Control>
+void sample_cm(DegreeSequence ds, double alpha, RNG &rng, Sink &sink, Control &control) {
+    if (simple_acceptance(ds) >= configuration_min_acceptance)
+        sample_configuration(ds, rng, sink, control);
+    else
+        sample(std::move(ds), alpha, rng, sink, control);
+}
+
+template<typename RNG, typename Sink>
+void sample_cm(DegreeSequence ds, double alpha, RNG &rng, Sink &sink) {
+    NoControl control;
+    sample_cm(std::move(ds), alpha, rng, sink, control);
+}
+
+// Sample loop-free multigraphs using the configuration model with rejection if the predicted acceptance
+// probability is at least configuration_min_acceptance, and sample_multi() otherwise.
+template<typename RNG, typename Sink, typename Control>
+void sample_multi_cm(DegreeSequenceMulti ds, double alpha, RNG &rng, Sink &sink, Control &control) {
+    if (loop_free_acceptance(ds) >= configuration_min_acceptance)
+        sample_configuration_multi(ds, rng, sink, control);
+    else
+        sample_multi(std::move(ds), alpha, rng, sink, control);
+}
+
+template<typename RNG, typename Sink>
+void sample_multi_cm(DegreeSequenceMulti ds, double alpha, RNG &rng, Sink &sink) {
+    NoControl control;
+    sample_multi_cm(std::move(ds), alpha, rng, sink, control);
+}
+
+} // namespace CDS
+
+#endif // CDS_CONFIGURATION_MODEL_H
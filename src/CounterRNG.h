@@ -0,0 +1,83 @@
+#ifndef CDS_COUNTER_RNG_H
+#define CDS_COUNTER_RNG_H
+
+#include <cstdint>
+#include <limits>
+
+namespace CDS {
+
+// Counter-based random number generator, Philox4x32-10.
+// Salmon et al., Parallel random numbers: as easy as 1, 2, 3, https://doi.org/10.1145/2063384.2063405
+//
+// The output is a fixed function of the key, the stream number and the position within the stream.
+// Generators with the same key but different stream numbers produce non-overlapping sequences,
+// which makes it possible to assign one stream to each sample and get reproducible results
+// regardless of how samples are distributed between threads or processes.
+// Satisfies the UniformRandomBitGenerator requirements.
+class CounterRNG {
+
+    uint32_t key[2];
+    uint32_t ctr[4];   // ctr[0], ctr[1]: position within the stream; ctr[2], ctr[3]: stream number
+    uint32_t out[4];   // current output block
+    int idx;           // next unused element of 'out'
+
+    static void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo) {
+        uint64_t p = uint64_t(a) * b;
+        hi = p >> 32;
+        lo = uint32_t(p);
+    }
+
+    void generate_block() {
+        uint32_t c[4] = { ctr[0], ctr[1], ctr[2], ctr[3] };
+        uint32_t k[2] = { key[0], key[1] };
+
+        for (int round=0; round < 10; ++round) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53, c[0], hi0, lo0);
+            mulhilo(0xCD9E8D57, c[2], hi1, lo1);
+            c[0] = hi1 ^ c[1] ^ k[0];
+            c[1] = lo1;
+            c[2] = hi0 ^ c[3] ^ k[1];
+            c[3] = lo0;
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+        }
+
+        for (int i=0; i < 4; ++i)
+            out[i] = c[i];
+        idx = 0;
+
+        // Advance the 64-bit position within the stream.
+        if (++ctr[0] == 0)
+            ++ctr[1];
+    }
+
+public:
+
+    typedef uint32_t result_type;
+
+    explicit CounterRNG(uint64_t key_ = 0, uint64_t stream = 0) { seed(key_, stream); }
+
+    void seed(uint64_t key_, uint64_t stream = 0) {
+        key[0] = uint32_t(key_);
+        key[1] = uint32_t(key_ >> 32);
+        ctr[0] = 0;
+        ctr[1] = 0;
+        ctr[2] = uint32_t(stream);
+        ctr[3] = uint32_t(stream >> 32);
+        idx = 4;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator () () {
+        if (idx == 4)
+            generate_block();
+        return out[idx++];
+    }
+};
+
+} // namespace CDS
+
+#endif // CDS_COUNTER_RNG_H
@@ -16,13 +16,23 @@ using std::vector;
 // Keeps track of information useful for sampling simple graphs.
 class DegreeSequence {
 
-    vector<deg_t> degseq;     // the degree sequence
-    const int n;              // number of degrees
+    // Data that is always accessed together is stored together, to reduce cache misses.
 
-    vector<int> deg_counts;   // deg_counts[d] is the number of vertices with degree d
-    vector<int> accum_counts; // accum_counts[d] is the number of vertices with degree <= d
-    vector<int> sorted_verts; // vertex indices sorted by vertex degree
-    vector<int> sorted_index; // sorted_index[u] is the index of vertex u in sorted_verts, i.e. sorted_verts[sorted_index[u]] == u
+    struct Vertex {
+        deg_t degree;             // the degree of the vertex
+        int sorted_index;         // the index of the vertex in sorted_verts, i.e. sorted_verts[sorted_index] is the vertex
+    };
+
+    struct Count {
+        int count;                // the number of vertices with degree d
+        int accum;                // the number of vertices with degree <= d
+    };
+
+    vertex_vector<Vertex> verts;  // the degree sequence
+    int n;                        // number of degrees
+
+    vertex_vector<Count> counts;  // counts[d] holds the counts for degree d
+    vertex_vector<int> sorted_verts; // vertex indices sorted by vertex degree
 
     deg_t dmax, dmin;         // largest and smallest non-zero (!) degree, assuming n_nonzero != 0
     int n_nonzero;            // number of non-zero degrees
@@ -30,7 +40,7 @@ class DegreeSequence {
 
     // d(i) returns d_i in the non-increasingly sorted degree sequence.
     // Note that i is assumed to use 1-based indexing!
-    deg_t d(int i) const { return degseq[sorted_verts[n - i]]; }
+    deg_t d(int i) const { return verts[sorted_verts[n - i]].degree; }
 
 public:
 
@@ -39,19 +49,21 @@ public:
     // Initialize degree sequence, O(n)
     template<typename It>
     DegreeSequence(It first, It last) :
-        degseq(first, last),
-        n(degseq.size()),
-        deg_counts(n),
-        sorted_verts(n), sorted_index(n),
-        accum_counts(n)
+        n(std::distance(first, last)),
+        counts(n),
+        sorted_verts(n)
     {
+        verts.reserve(n);
+        for (; first != last; ++first)
+            verts.push_back({deg_t(*first), 0});
+
         // Initialize sorted_verts
         std::iota(sorted_verts.begin(), sorted_verts.end(), 0);
-        std::sort(sorted_verts.begin(), sorted_verts.end(), [this] (int u, int v) { return degseq[u] < degseq[v]; } );
+        std::sort(sorted_verts.begin(), sorted_verts.end(), [this] (int u, int v) { return verts[u].degree < verts[v].degree; } );
 
-        // Initialize sorted_index
+        // Initialize sorted indices
         for (int i=0; i < n; ++i)
-            sorted_index[sorted_verts[i]] = i;
+            verts[sorted_verts[i]].sorted_index = i;
 
         dmax = 0;
         dmin = 0;
@@ -59,7 +71,7 @@ public:
         dsum = 0;
 
         for (int i=0; i < n; ++i) {
-            deg_t d = degseq[i];
+            deg_t d = verts[i].degree;
 
             if (d < 0)
                 throw std::domain_error("Degrees must be non-negative.");
@@ -75,7 +87,7 @@ public:
                 n_nonzero++;
             }
 
-            deg_counts[d] += 1;
+            counts[d].count += 1;
 
             dsum += d;
         }
@@ -85,21 +97,26 @@ public:
             throw std::invalid_argument("The degree sequence is not graphical.");
         */
 
-        // Initialize accum_counts
-        std::partial_sum(deg_counts.begin(), deg_counts.end(), accum_counts.begin());
+        // Initialize accumulated counts
+        int accum = 0;
+        for (auto &c : counts) {
+            accum += c.count;
+            c.accum = accum;
+        }
     }
 
     // Decrement the degree of vertex u, O(1)
     void decrement(int u) {
-        int d = degseq[u];
+        Vertex &vu = verts[u];
+        int d = vu.degree;
         Assert(d > 0);
 
-        degseq[u]--;
+        vu.degree--;
 
-        deg_counts[d]--;
-        deg_counts[d-1]++;
+        counts[d].count--;
+        counts[d-1].count++;
 
-        if (deg_counts[dmax] == 0)
+        if (counts[dmax].count == 0)
             dmax -= 1;
 
         if (d == 1)
@@ -111,27 +128,28 @@ public:
                 dmin -= 1;
         }
 
-        int si_old = sorted_index[u];
-        int si_new = accum_counts[d-1];
+        int si_old = vu.sorted_index;
+        int si_new = counts[d-1].accum;
 
         int v = sorted_verts[si_new];
-        sorted_index[u] = si_new;
-        sorted_index[v] = si_old;
+        vu.sorted_index = si_new;
+        verts[v].sorted_index = si_old;
 
         std::swap(sorted_verts[si_old], sorted_verts[si_new]);
 
-        accum_counts[d-1]++;
+        counts[d-1].accum++;
     }
 
     // Increment the degree of vertex u, O(1)
     void increment(int u) {
-        int d = degseq[u];
+        Vertex &vu = verts[u];
+        int d = vu.degree;
         Assert(d < n-1);
 
-        degseq[u]++;
+        vu.degree++;
 
-        deg_counts[d]--;
-        deg_counts[d+1]++;
+        counts[d].count--;
+        counts[d+1].count++;
 
         if (dmax == d)
             dmax += 1;
@@ -141,16 +159,16 @@ public:
             dmin = 0;
         }
 
-        int si_old = sorted_index[u];
-        int si_new = accum_counts[d] - 1;
+        int si_old = vu.sorted_index;
+        int si_new = counts[d].accum - 1;
 
         int v = sorted_verts[si_new];
-        sorted_index[u] = si_new;
-        sorted_index[v] = si_old;
+        vu.sorted_index = si_new;
+        verts[v].sorted_index = si_old;
 
         std::swap(sorted_verts[si_old], sorted_verts[si_new]);
 
-        accum_counts[d]--;
+        counts[d].accum--;
     }
 
     // Connect vertices u and v, O(1)
@@ -173,15 +191,15 @@ public:
             if (dk < k+1)
                 return true;
 
-            int run_size = deg_counts[dk];
+            int run_size = counts[dk].count;
             if (run_size > 0) {
                 if (dk < k + run_size) {
                     run_size = dk - k;
                 }
                 sum_deg += run_size * dk;
                 for (int v=0; v < run_size; ++v) {
-                    sum_ni  += deg_counts[k+v];
-                    sum_ini += (k+v) * deg_counts[k+v];
+                    sum_ni  += counts[k+v].count;
+                    sum_ini += (k+v) * counts[k+v].count;
                 }
                 k += run_size;
                 if (sum_deg > k*(n-1) - k*sum_ni + sum_ini)
@@ -192,7 +210,7 @@ public:
         return true;
     }
 
-    // The smallest degree which may be connected to without breaking graphicality, O(n)
+    // The smallest degree which may be connected to without breaking graphicality, O(n) in the worst case
     // Before calling this function, all but one degree of the current vertex must have been
     // connected to the largest non-excluded other degrees, then the current vertex must have
     // been removed. Thefore, at this point the degree sum is odd. We check which degree
@@ -208,9 +226,12 @@ public:
         for (int k=1; k <= n; ++k) {
             lhs += d(k);
 
-            while (d(s) < k && s >= k) {
-                r += d(s);
-                s--;
+            // Move past all vertices with degree d(s) < k at once, using the degree counts.
+            while (s >= k && d(s) < k) {
+                deg_t deg = d(s);
+                int run = std::min(counts[deg].accum - (n - s), s - k + 1);
+                r += run*deg;
+                s -= run;
             }
 
             if (s < k)
@@ -233,23 +254,32 @@ public:
 
     // Access to degrees:
 
-    const deg_t & operator [] (int v) const { return degseq[v]; }
-
-    auto begin() const { return degseq.begin(); }
-    auto end() const { return degseq.end(); }
+    const deg_t & operator [] (int v) const { return verts[v].degree; }
 
     int size() const { return n; }
 
-    const vector<deg_t> &degrees() const { return degseq; }
-    const vector<int> &degree_distribution() const { return deg_counts; }
+    // The degree sequence, O(n)
+    vector<deg_t> degrees() const {
+        vector<deg_t> result;
+        result.reserve(n);
+        for (const auto &v : verts)
+            result.push_back(v.degree);
+        return result;
+    }
 
-    // Sampling functions have access to internals:
+    // The number of vertices with each degree, O(n)
+    vector<int> degree_distribution() const {
+        vector<int> result;
+        result.reserve(n);
+        for (const auto &c : counts)
+            result.push_back(c.count);
+        return result;
+    }
 
-    template<typename RNG>
-    friend std::tuple<edgelist_t, double> sample(DegreeSequence ds, double alpha, RNG &rng);
+    // The sampling engine has access to internals:
 
-    template<typename RNG>
-    friend std::tuple<edgelist_t, double> sample_conn(DegreeSequence ds, double alpha, RNG &rng);
+    friend class SimpleGraphs;
+    friend class ReferenceSimpleGraphs;
 };
 
 } // namespace CDS
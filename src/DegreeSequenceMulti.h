@@ -78,11 +78,9 @@ public:
 
     const vector<deg_t> &degrees() const { return degseq; }
 
-    template<typename RNG>
-    friend std::tuple<edgelist_t, double> sample_multi(DegreeSequenceMulti ds, double alpha, RNG &rng);
+    // The sampling engine has access to internals:
 
-    template<typename RNG>
-    friend std::tuple<edgelist_t, double> sample_conn_multi(DegreeSequenceMulti ds, double alpha, RNG &rng);
+    friend class MultiGraphs;
 };
 
 } // namespace CDS
@@ -0,0 +1,38 @@
+#ifndef CDS_EDGE_SINK_H
+#define CDS_EDGE_SINK_H
+
+#include "Common.h"
+
+#include <tuple>
+#include <utility>
+
+namespace CDS {
+
+// The samplers do not store the graph they generate. Instead, they pass each edge to a sink
+// as soon as it is chosen. A sink is any object with the following member functions:
+//
+//   void edge(int u, int v);       // called once for each edge of the sample
+//   void finish(double logprob);   // called once the sample is complete
+//
+// This way, writers and statistics accumulators can consume edges directly,
+// without an intermediate edge list.
+
+
+// Collects edges into an edge list. Used to implement the tuple-returning sampling functions.
+class EdgeListSink {
+    edgelist_t edges;
+    double logprob;
+
+public:
+
+    EdgeListSink() : logprob(0) { }
+
+    void edge(int u, int v) { edges.push_back({u, v}); }
+    void finish(double lp) { logprob = lp; }
+
+    std::tuple<edgelist_t, double> result() { return std::make_tuple(std::move(edges), logprob); }
+};
+
+} // namespace CDS
+
+#endif // CDS_EDGE_SINK_H
@@ -0,0 +1,219 @@
+#ifndef CDS_EDGE_SWAP_CHAIN_H
+#define CDS_EDGE_SWAP_CHAIN_H
+
+#include "Common.h"
+
+#include <vector>
+#include <unordered_set>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+
+namespace CDS {
+
+// Markov chain over the simple graphs with a given degree sequence, using double edge swaps.
+//
+// Each step picks two edges (a,b), (c,d) uniformly at random and proposes to replace them
+// by (a,c), (b,d), or by (a,d), (b,c) with equal probability. The proposal is rejected if it
+// would create a self-loop or a multi-edge, or, if 'connected' is set, if it would disconnect the graph.
+// The proposal distribution is symmetric, thus the stationary distribution is uniform over
+// all (connected) simple realizations of the degree sequence. Consecutive states are correlated,
+// thus the chain must be thinned and its autocorrelation checked.
+//
+// The chain must be started from a valid realization, e.g. one produced by sample() or sample_conn().
+class EdgeSwapChain {
+
+    int n;
+    edgelist_t edge_list;
+    std::vector<std::vector<int>> adj;      // adjacency lists
+    std::unordered_set<uint64_t> edge_set;  // all edges, for O(1) multi-edge rejection
+    bool connected;
+
+    long attempted_count, accepted_count;
+
+    // Workspace for the connectivity search
+    ExclusionSet seen_a, seen_b;
+    std::vector<int> queue_a, queue_b;
+
+    static uint64_t key(int u, int v) {
+        if (u > v)
+            std::swap(u, v);
+        return (uint64_t(u) << 32) | uint32_t(v);
+    }
+
+    bool has_edge(int u, int v) const { return edge_set.count(key(u, v)) > 0; }
+
+    void add_edge(int u, int v) {
+        edge_set.insert(key(u, v));
+        adj[u].push_back(v);
+        adj[v].push_back(u);
+    }
+
+    static void remove_neighbour(std::vector<int> &list, int v) {
+        auto it = std::find(list.begin(), list.end(), v);
+        *it = list.back();
+        list.pop_back();
+    }
+
+    void remove_edge(int u, int v) {
+        edge_set.erase(key(u, v));
+        remove_neighbour(adj[u], v);
+        remove_neighbour(adj[v], u);
+    }
+
+    // Process one vertex from the front of 'queue'. Returns true if the search met the other one.
+    bool expand(std::vector<int> &queue, size_t &head, ExclusionSet &seen, const ExclusionSet &other) {
+        int u = queue[head++];
+        for (int v : adj[u]) {
+            if (other[v])
+                return true;
+            if (! seen[v]) {
+                seen.insert(v);
+                queue.push_back(v);
+            }
+        }
+        return false;
+    }
+
+    // Is there a path between a and b? Breadth-first searches are run from both ends, alternating
+    // between them, so that if a and b are disconnected, the cost is proportional to the smaller component.
+    bool reachable(int a, int b) {
+        if (a == b)
+            return true;
+
+        seen_a.clear();
+        seen_b.clear();
+        queue_a.assign(1, a);
+        queue_b.assign(1, b);
+        seen_a.insert(a);
+        seen_b.insert(b);
+
+        size_t head_a = 0, head_b = 0;
+        while (head_a < queue_a.size() && head_b < queue_b.size()) {
+            if (expand(queue_a, head_a, seen_a, seen_b))
+                return true;
+            if (expand(queue_b, head_b, seen_b, seen_a))
+                return true;
+        }
+        return false;
+    }
+
+    bool is_connected() {
+        if (n == 0)
+            return false;
+
+        seen_a.clear();
+        queue_a.assign(1, 0);
+        seen_a.insert(0);
+        for (size_t head=0; head < queue_a.size(); ++head)
+            for (int v : adj[queue_a[head]])
+                if (! seen_a[v]) {
+                    seen_a.insert(v);
+                    queue_a.push_back(v);
+                }
+        return int(queue_a.size()) == n;
+    }
+
+public:
+
+    // 'n' is the number of vertices. The edges must form a simple graph, which must be connected if 'connected' is set.
+    EdgeSwapChain(int n, edgelist_t edges, bool connected) :
+        n(n),
+        edge_list(std::move(edges)),
+        adj(n),
+        connected(connected),
+        attempted_count(0), accepted_count(0),
+        seen_a(n), seen_b(n)
+    {
+        for (const auto &e : edge_list) {
+            if (e.first < 0 || e.first >= n || e.second < 0 || e.second >= n)
+                throw std::invalid_argument("Edge swap chain: Vertex index out of range.");
+            if (e.first == e.second || has_edge(e.first, e.second))
+                throw std::invalid_argument("Edge swap chain: The starting graph must be simple.");
+            add_edge(e.first, e.second);
+        }
+
+        if (connected && ! is_connected())
+            throw std::invalid_argument("Edge swap chain: The starting graph must be connected.");
+    }
+
+    int size() const { return n; }
+    const edgelist_t &edges() const { return edge_list; }
+
+    long attempted() const { return attempted_count; }
+    long accepted() const { return accepted_count; }
+
+    // Attempt a single swap. Returns true if it was accepted.
+    template<typename RNG>
+    bool step(RNG &rng) {
+        attempted_count++;
+
+        const int m = edge_list.size();
+        if (m < 2)
+            return false;
+
+        std::uniform_int_distribution<int> choose(0, m-1);
+        int i = choose(rng);
+        int j = choose(rng);
+        if (i == j)
+            return false;
+
+        int a = edge_list[i].first, b = edge_list[i].second;
+        int c = edge_list[j].first, d = edge_list[j].second;
+        if (std::uniform_int_distribution<int>(0, 1)(rng))
+            std::swap(c, d);
+
+        // Proposed new edges: (a,c), (b,d)
+        if (a == c || b == d || has_edge(a, c) || has_edge(b, d))
+            return false;
+
+        remove_edge(a, b);
+        remove_edge(c, d);
+        add_edge(a, c);
+        add_edge(b, d);
+
+        // All vertices remain connected to one of a, b, c, d; a-c and b-d are adjacent.
+        // Thus the graph stays connected if and only if a and b are still connected.
+        if (connected && ! reachable(a, b)) {
+            remove_edge(a, c);
+            remove_edge(b, d);
+            add_edge(a, b);
+            add_edge(c, d);
+            return false;
+        }
+
+        edge_list[i] = {a, c};
+        edge_list[j] = {b, d};
+
+        accepted_count++;
+        return true;
+    }
+
+    // Attempt 'steps' swaps. Returns the number of accepted swaps.
+    template<typename RNG>
+    long run(long steps, RNG &rng) {
+        long count = 0;
+        for (long s=0; s < steps; ++s)
+            count += step(rng);
+        return count;
+    }
+
+    // Number of triangles in the current graph, O(sum over edges of the smaller endpoint degree)
+    long triangle_count() const {
+        long count = 0;
+        for (const auto &e : edge_list) {
+            int u = e.first, v = e.second;
+            if (adj[u].size() > adj[v].size())
+                std::swap(u, v);
+            for (int w : adj[u])
+                if (w != v && has_edge(w, v))
+                    count++;
+        }
+        return count / 3;
+    }
+};
+
+} // namespace CDS
+
+#endif // CDS_EDGE_SWAP_CHAIN_H
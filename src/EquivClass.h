@@ -5,22 +5,30 @@
 #include "DegreeSequence.h"
 
 #include <stdexcept>
+#include <atomic>
 
 namespace CDS {
 
 // Used for equivalence class computation.
+//
+// Lookups compress paths, thus they write to the elements. Lookups may run concurrently, e.g. from the parallel
+// scan of the allowed vertices, as long as no classes are merged at the same time: all writers then store
+// the same class element. Relaxed atomics make this well-defined at no cost over plain pointers.
 template<typename T>
 class EquivClassElement {
     T val;
-    EquivClassElement *equiv;
+    std::atomic<EquivClassElement *> equiv;
     deg_t deg;
 
+    EquivClassElement *next() const { return equiv.load(std::memory_order_relaxed); }
+    void set_next(EquivClassElement *e) { equiv.store(e, std::memory_order_relaxed); }
+
 public:
 
     EquivClassElement(const EquivClassElement &) = delete;
     EquivClassElement & operator = (const EquivClassElement &) = delete;
 
-    EquivClassElement() { equiv = this; }
+    EquivClassElement() : equiv(this) { }
 
     void set_value(const T &newVal) { val = newVal; }
     T value() const { return val; }
@@ -29,27 +37,27 @@ public:
     deg_t degree() const { return deg; }
 
     EquivClassElement *get_class_elem() {
-        EquivClassElement *final = equiv;
-        while (final != final->equiv)
-            final = final->equiv;
+        EquivClassElement *final = next();
+        while (final != final->next())
+            final = final->next();
 
         // If updating is needed, do a full second pass and update each node of the chain.
-        if (final != equiv) {
+        if (final != next()) {
             EquivClassElement *e1 = this;
-            while (e1 != e1->equiv) {
-                EquivClassElement *e2 = e1->equiv;
-                e1->equiv = final;
+            while (e1 != e1->next()) {
+                EquivClassElement *e2 = e1->next();
+                e1->set_next(final);
                 e1 = e2;
             }
         }
 
-        return equiv;
+        return final;
     }
 
     void update_class(EquivClassElement *elem) {
         EquivClassElement *newClass = elem->get_class_elem();
-        get_class_elem()->equiv = newClass;
-        equiv = newClass;
+        get_class_elem()->set_next(newClass);
+        set_next(newClass);
     }
 
 };
@@ -113,6 +121,11 @@ public:
     void connect(int a, int b) {
         n_edges--;
 
+        // With a single supernode, every connection is allowed until the end, see connectable().
+        // The class degree is no longer needed, so tracking stops here.
+        if (n_supernodes == 1)
+            return;
+
         auto classA = elems[a].get_class_elem();
         auto classB = elems[b].get_class_elem();
 
@@ -138,10 +151,52 @@ public:
 
     auto get_class(int u) const { return elems[u].get_class_elem(); }
 
+    // The number of free stubs of u's component. The class degree is no longer updated once there is a single
+    // component, see connect(), but then all free stubs are in it.
+    deg_t component_stubs(int u) const { return n_supernodes == 1 ? 2*n_edges : get_class(u)->degree(); }
+
     bool is_potentially_connected() const {
         return !closed && n_edges >= n_supernodes-1;
     }
 
+    // Returns true if connecting u to any vertex v will not break potential connectivity.
+    // When this is false, connectable(u, v) must be checked for each v.
+    bool connectable_to_all(int u) const {
+        deg_t cud = get_class(u)->degree();
+        return n_supernodes == 1 ||
+               n_edges == 1 ||
+               (cud > 2 && n_edges > n_supernodes - 1);
+    }
+
+    // Connectability test for a fixed vertex u, used when scanning the candidates v.
+    // Whether u can connect to v depends on v only through its class and the degree of that class, thus
+    // everything that depends on u alone is evaluated once, when the test is created, instead of for each v.
+    class ConnectableFrom {
+        const EquivClass &ec;
+        const Element *cu;
+        bool to_all;    // u may connect to any vertex
+        bool cud_free;  // u's class has more than one free stub, thus it may connect to any other class
+
+    public:
+        ConnectableFrom(const EquivClass &ec, int u) :
+            ec(ec),
+            cu(ec.get_class(u)),
+            to_all(ec.connectable_to_all(u)),
+            cud_free(cu->degree() > 1)
+        { }
+
+        bool all() const { return to_all; }
+
+        bool operator () (int v) const {
+            if (to_all)
+                return true;
+            auto cv = ec.get_class(v);
+            return cv != cu && (cud_free || cv->degree() > 1);
+        }
+    };
+
+    ConnectableFrom connectable_from(int u) const { return ConnectableFrom(*this, u); }
+
     // Returns true if connecting u to v will not break potential connectivity
     bool connectable(int u, int v) const {
         auto cu = get_class(u);
@@ -0,0 +1,73 @@
+#ifndef CDS_FENWICK_TREE_H
+#define CDS_FENWICK_TREE_H
+
+#include "Common.h"
+
+namespace CDS {
+
+// Fenwick tree (binary indexed tree) over the elements 0 .. n-1.
+// Supports updating an element, prefix sums, and finding the position of a given
+// cumulative sum, all in O(log n). Used for weighted sampling from sets that change
+// by a few elements at a time. The elements must be non-negative for find() to work.
+template<typename T>
+class FenwickTree {
+    vertex_vector<T> tree; // 1-based, tree[i] holds the sum of the elements i - lowbit(i) .. i-1
+    int n;
+    int top;               // largest power of two not exceeding n
+
+public:
+
+    FenwickTree() : n(0), top(0) { }
+
+    // Build from the given values, O(n)
+    template<typename Container>
+    explicit FenwickTree(const Container &values) :
+        tree(values.size() + 1),
+        n(values.size())
+    {
+        for (int i=1; i <= n; ++i) {
+            tree[i] += values[i-1];
+            int parent = i + (i & -i);
+            if (parent <= n)
+                tree[parent] += tree[i];
+        }
+
+        top = 1;
+        while (2*top <= n)
+            top *= 2;
+    }
+
+    int size() const { return n; }
+
+    // Add 'delta' to element i
+    void add(int i, T delta) {
+        for (++i; i <= n; i += i & -i)
+            tree[i] += delta;
+    }
+
+    // Sum of the elements 0 .. i. Returns 0 for i < 0.
+    T prefix_sum(int i) const {
+        T sum = 0;
+        for (++i; i > 0; i -= i & -i)
+            sum += tree[i];
+        return sum;
+    }
+
+    T total() const { return prefix_sum(n-1); }
+
+    // The smallest i for which prefix_sum(i) > target. Returns n if there is no such i.
+    int find(T target) const {
+        int pos = 0;
+        for (int step = top; step > 0; step /= 2) {
+            if (pos + step <= n && tree[pos + step] <= target) {
+                pos += step;
+                target -= tree[pos];
+            }
+        }
+        return pos;
+    }
+};
+
+} // namespace CDS
+
+#endif // CDS_FENWICK_TREE_H
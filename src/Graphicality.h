@@ -0,0 +1,125 @@
+#ifndef CDS_GRAPHICALITY_H
+#define CDS_GRAPHICALITY_H
+
+#include "Common.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace CDS {
+
+using std::vector;
+
+// Classification of degree sequences without constructing a DegreeSequence, for screening many candidate sequences.
+// The tests work on the number of vertices of each degree, so no sorting is needed, and take O(n + dmax) time.
+struct SequenceClass {
+    enum : unsigned char {
+        graphical = 1,             // realized by a simple graph, as DegreeSequence::is_graphical()
+        multigraphical = 2,        // realized by a loop-free multigraph, as DegreeSequenceMulti::is_multigraphical()
+        potentially_connected = 4  // the degree sum is even, no vertex is isolated unless n = 1, and there are at least n-1 edges
+    };
+};
+
+// Potential connectedness is the condition checked by EquivClass, except that the null graph is not potentially
+// connected, as with the connected samplers. The sequence has a connected simple graph realization if and only if it
+// is both graphical and potentially connected, and likewise for multigraphs. Sequences with a negative degree
+// belong to no class.
+//
+// The workspace is kept between calls, so that classifying many sequences does not allocate memory.
+class SequenceClassifier {
+    vector<int> counts; // counts[d]: the number of vertices of degree d
+
+    // Erdős–Gallai test on the degree counts, as DegreeSequence::is_graphical()
+    bool erdos_gallai(long n, long dmin, long dmax, long n_nonzero) const {
+        if (n_nonzero == 0 || 4*dmin*n_nonzero >= sqr(dmax + dmin + 1))
+            return true;
+
+        long k = 0, sum_deg = 0, sum_ni = 0, sum_ini = 0;
+        for (long dk = dmax; dk >= dmin; --dk) {
+            if (dk < k+1)
+                return true;
+
+            long run_size = counts[dk];
+            if (run_size > 0) {
+                if (dk < k + run_size) {
+                    run_size = dk - k;
+                }
+                sum_deg += run_size * dk;
+                for (long v=0; v < run_size; ++v) {
+                    sum_ni  += counts[k+v];
+                    sum_ini += (k+v) * counts[k+v];
+                }
+                k += run_size;
+                if (sum_deg > k*(n-1) - k*sum_ni + sum_ini)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+public:
+
+    // Classify the degree sequence [first, last), returning a combination of SequenceClass flags
+    template<typename It>
+    unsigned char classify(It first, It last) {
+        const long n = std::distance(first, last);
+
+        long dsum = 0, dmax = 0, dmin = n, n_nonzero = 0, n_zero = 0;
+        for (It it = first; it != last; ++it) {
+            const long d = *it;
+            if (d < 0)
+                return 0;
+            dsum += d;
+            dmax = std::max(dmax, d);
+            if (d > 0) {
+                dmin = std::min(dmin, d);
+                n_nonzero++;
+            } else {
+                n_zero++;
+            }
+        }
+
+        if (dsum % 2 == 1)
+            return 0;
+
+        unsigned char result = 0;
+
+        if (dsum >= 2*dmax)
+            result |= SequenceClass::multigraphical;
+
+        if (n > 0 && (n_zero == 0 || n == 1) && dsum/2 >= n-1)
+            result |= SequenceClass::potentially_connected;
+
+        if (dmax < std::max(n, 1L)) { // the null graph is graphical
+            counts.assign(dmax + 1, 0);
+            for (It it = first; it != last; ++it)
+                counts[*it]++;
+            if (erdos_gallai(n, dmin, dmax, n_nonzero))
+                result |= SequenceClass::graphical;
+        }
+
+        return result;
+    }
+};
+
+// Classify 'count' degree sequences given as a ragged array: sequence i is values[offsets[i]] .. values[offsets[i+1] - 1].
+// The class of sequence i, a combination of SequenceClass flags, is stored in result[i].
+// The sequences are split into blocks, which are classified in parallel using 'pool'.
+template<typename Value, typename Offset>
+void classify_sequences(const Value *values, const Offset *offsets, long count, unsigned char *result, ThreadPool &pool) {
+    const long block_size = 4096;
+    const long blocks = (count + block_size - 1) / block_size;
+
+    pool.parallel_for(blocks, [&] (long block) {
+        SequenceClassifier classifier;
+        const long end = std::min(count, (block + 1) * block_size);
+        for (long i = block * block_size; i < end; ++i)
+            result[i] = classifier.classify(values + offsets[i], values + offsets[i+1]);
+    });
+}
+
+} // namespace CDS
+
+#endif // CDS_GRAPHICALITY_H
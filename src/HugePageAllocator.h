@@ -0,0 +1,66 @@
+#ifndef CDS_HUGE_PAGE_ALLOCATOR_H
+#define CDS_HUGE_PAGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace CDS {
+
+// Allocator for the per-vertex arrays of the samplers.
+// Small arrays are allocated normally. Arrays of at least 'threshold' bytes, i.e. from about
+// 4.2 million vertices with 8-byte records and 8.4 million with 4-byte entries, are allocated
+// using mmap() and backed by transparent huge pages where available. This reduces TLB misses during the random
+// accesses that the samplers make into these arrays.
+// On systems other than Linux, this is equivalent to std::allocator.
+template<typename T>
+class HugePageAllocator {
+public:
+    typedef T value_type;
+
+    static constexpr std::size_t threshold = std::size_t(1) << 25; // 32 MiB
+
+    HugePageAllocator() = default;
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U> &) { }
+
+    T *allocate(std::size_t n) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        const std::size_t bytes = n*sizeof(T);
+        if (bytes >= threshold) {
+            void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            madvise(p, bytes, MADV_HUGEPAGE); // only a hint, failure is not an error
+            return static_cast<T *>(p);
+        }
+#endif
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        const std::size_t bytes = n*sizeof(T);
+        if (bytes >= threshold) {
+            munmap(p, bytes);
+            return;
+        }
+#endif
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template<typename T, typename U>
+bool operator == (const HugePageAllocator<T> &, const HugePageAllocator<U> &) { return true; }
+
+template<typename T, typename U>
+bool operator != (const HugePageAllocator<T> &, const HugePageAllocator<U> &) { return false; }
+
+} // namespace CDS
+
+#endif // CDS_HUGE_PAGE_ALLOCATOR_H
@@ -0,0 +1,397 @@
+#ifndef CDS_IMPLICIT_DEGREE_SEQUENCE_H
+#define CDS_IMPLICIT_DEGREE_SEQUENCE_H
+
+#include "Common.h"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <stdexcept>
+
+namespace CDS {
+
+using std::vector;
+
+// A degree sequence stored only as the number of vertices of each degree.
+// Supports the same updates, graphicality test and watershed computation as DegreeSequence,
+// without any per-vertex data. The updates are O(1), the computations O(dmax).
+class DegreeCounts {
+
+    struct Count {
+        int count;                // the number of vertices with degree d
+        int accum;                // the number of vertices with degree <= d
+    };
+
+    vector<Count> counts;         // counts[d] for 0 <= d <= largest initial degree
+    int n;                        // number of vertices
+    deg_t dmax;                   // largest degree
+    long dsum;                    // sum of degrees
+
+public:
+
+    DegreeCounts() : n(0), dmax(0), dsum(0) { }
+
+    // Initialize from the number of vertices with each degree, O(dmax)
+    explicit DegreeCounts(const vector<int> &count_of_degree) :
+        counts(std::max<std::size_t>(count_of_degree.size(), 1)),
+        n(0), dmax(0), dsum(0)
+    {
+        for (std::size_t d=0; d < count_of_degree.size(); ++d) {
+            counts[d].count = count_of_degree[d];
+            n += count_of_degree[d];
+            dsum += long(d) * count_of_degree[d];
+            if (count_of_degree[d] > 0)
+                dmax = d;
+        }
+
+        int accum = 0;
+        for (auto &c : counts) {
+            accum += c.count;
+            c.accum = accum;
+        }
+    }
+
+    // Move one vertex from degree d to d-1, O(1)
+    void decrement(deg_t d) {
+        Assert(d > 0 && counts[d].count > 0);
+
+        counts[d].count--;
+        counts[d-1].count++;
+        counts[d-1].accum++;
+        dsum--;
+
+        if (counts[dmax].count == 0)
+            dmax -= 1;
+    }
+
+    // Move one vertex from degree d to d+1, O(1)
+    void increment(deg_t d) {
+        Assert(d+1 < deg_t(counts.size()) && counts[d].count > 0);
+
+        counts[d].count--;
+        counts[d+1].count++;
+        counts[d].accum--;
+        dsum++;
+
+        if (dmax == d)
+            dmax += 1;
+    }
+
+    int count(deg_t d) const { return counts[d].count; }
+    int size() const { return n; }
+    deg_t max_degree() const { return dmax; }
+    long degree_sum() const { return dsum; }
+
+    // Graphicality test, as DegreeSequence::is_graphical(), O(dmax)
+    bool is_graphical() const {
+
+        if (dsum % 2 == 1)
+            return false;
+
+        long k = 0, sum_deg = 0, sum_ni = 0, sum_ini = 0;
+        for (deg_t dk = dmax; dk >= 1; --dk) {
+            if (dk < k+1)
+                return true;
+
+            long run_size = counts[dk].count;
+            if (run_size > 0) {
+                if (dk < k + run_size) {
+                    run_size = dk - k;
+                }
+                sum_deg += run_size * dk;
+                for (long v=0; v < run_size; ++v) {
+                    sum_ni  += counts[k+v].count;
+                    sum_ini += (k+v) * counts[k+v].count;
+                }
+                k += run_size;
+                if (sum_deg > k*(n-1) - k*sum_ni + sum_ini)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    // The watershed degree, as DegreeSequence::watershed(), O(dmax).
+    // The k-th largest degree is found by moving a cursor down the degree classes as k increases,
+    // and the s-th largest by moving another cursor up as s decreases.
+    deg_t watershed() const {
+        int wd = 0; // the watershed degree
+
+        long lhs = 0;
+
+        int s = n;
+        long r = 0;
+
+        deg_t top = dmax;   // d(k)
+        deg_t bottom = 0;   // d(s)
+
+        // The degree at position p of the non-decreasingly sorted sequence is the smallest d with accum > p
+        auto d_top = [&] (int k) {
+            while (top > 0 && counts[top-1].accum > n - k)
+                --top;
+            return top;
+        };
+        auto d_bottom = [&] (int s) {
+            while (counts[bottom].accum <= n - s)
+                ++bottom;
+            return bottom;
+        };
+
+        for (int k=1; k <= n; ++k) {
+            const deg_t dk = d_top(k);
+            lhs += dk;
+
+            // Move past all vertices with degree d(s) < k at once
+            while (s >= k && d_bottom(s) < k) {
+                deg_t deg = d_bottom(s);
+                int run = std::min(counts[deg].accum - (n - s), s - k + 1);
+                r += long(run)*deg;
+                s -= run;
+            }
+
+            if (s < k)
+                break;
+
+            long rhs = long(k)*(s-1) + r;
+
+            long diff = lhs - rhs;
+
+            Assert(diff <= 1);
+
+            if (diff == 1)
+                return dk;
+
+            if (diff == 0)
+                wd = k+1;
+        }
+        return wd;
+    }
+};
+
+
+// A run of 'count' consecutive vertices with the same degree
+struct DegreeRun {
+    deg_t degree;
+    int count;
+};
+
+// A degree sequence for very large graphs with few distinct degrees, e.g. 10^9 vertices with degrees
+// between 1 and 50. It is given as runs of equal degrees, which are stored instead of the individual degrees.
+//
+// Vertices are processed in order by the sampler. Until a vertex is first chosen, it is interchangeable with
+// all other untouched vertices of the same degree, thus it is only represented by the per-degree counts.
+// When an untouched vertex of a given degree is to be chosen, one of them is picked uniformly at random
+// and materialised: its current degree is stored from then on. Vertices before the one being processed have
+// no stubs left, and their state is dropped. Thus the memory use is proportional to the number of runs,
+// the largest degree, and the number of materialised vertices after the current one, rather than to n.
+class ImplicitDegreeSequence {
+
+    struct Segment {
+        int first;                // first vertex of the run
+        deg_t degree;
+        int rank;                 // number of vertices of this degree before 'first'
+    };
+
+    struct Vertex {
+        deg_t degree;             // current degree
+        deg_t initial;            // initial degree
+        int slot;                 // used by ImplicitSimpleGraphs: position in its list of eligible vertices, -1 if none
+    };
+
+    vector<Segment> segments;       // ordered by first vertex
+    vector<vector<int>> by_degree;  // by_degree[d]: indices of the segments of degree d, in order
+    vector<int> total;              // total[d]: the number of vertices of initial degree d
+    int n;
+
+    int frontier;                   // vertices before the frontier have no stubs left
+    std::unordered_map<int, Vertex> touched; // materialised vertices at or after the frontier
+    vector<int> remaining;          // remaining[d]: the number of vertices of initial degree d at or after the frontier
+    vector<int> touched_count;      // touched_count[d]: the number of these which are materialised
+
+    DegreeCounts counts;            // the number of vertices with each current degree
+
+    void init(const vector<DegreeRun> &runs) {
+        long size = 0;
+        deg_t dmax = 0;
+        for (const auto &run : runs) {
+            if (run.degree < 0 || run.count < 0)
+                throw std::domain_error("Degrees and run lengths must be non-negative.");
+            size += run.count;
+            if (run.count > 0)
+                dmax = std::max(dmax, run.degree);
+        }
+        if (size > std::numeric_limits<int>::max())
+            throw std::invalid_argument("Too many vertices.");
+        n = size;
+
+        if (n > 0 && dmax > n-1)
+            throw std::invalid_argument("The degree sequence is not graphical.");
+
+        by_degree.resize(dmax + 1);
+        total.assign(dmax + 1, 0);
+
+        int first = 0;
+        for (const auto &run : runs) {
+            if (run.count == 0)
+                continue;
+            if (segments.empty() || segments.back().degree != run.degree) { // otherwise merge with the previous run
+                by_degree[run.degree].push_back(segments.size());
+                segments.push_back({first, run.degree, total[run.degree]});
+            }
+            total[run.degree] += run.count;
+            first += run.count;
+        }
+
+        frontier = 0;
+        remaining = total;
+        touched_count.assign(dmax + 1, 0);
+        counts = DegreeCounts(total);
+    }
+
+    // The initial degree of v, O(log number of runs)
+    deg_t initial_degree(int v) const {
+        auto it = std::upper_bound(segments.begin(), segments.end(), v, [] (int v, const Segment &s) { return v < s.first; });
+        return (it - 1)->degree;
+    }
+
+    // The vertex with the given rank among those of initial degree d
+    int vertex_of_rank(deg_t d, int rank) const {
+        const auto &segs = by_degree[d];
+        auto it = std::upper_bound(segs.begin(), segs.end(), rank, [this] (int rank, int s) { return rank < segments[s].rank; });
+        const Segment &seg = segments[*(it - 1)];
+        return seg.first + (rank - seg.rank);
+    }
+
+public:
+
+    ImplicitDegreeSequence() : n(0), frontier(0) { }
+
+    // Initialize from runs of equal degrees, which are assigned to vertices 0, 1, ... in order, O(runs + dmax)
+    explicit ImplicitDegreeSequence(const vector<DegreeRun> &runs) { init(runs); }
+
+    // Initialize from a list of degrees, which are stored as runs of equal consecutive degrees
+    template<typename It>
+    ImplicitDegreeSequence(It first, It last) {
+        vector<DegreeRun> runs;
+        for (; first != last; ++first) {
+            const deg_t d = *first;
+            if (! runs.empty() && runs.back().degree == d && runs.back().count < std::numeric_limits<int>::max())
+                runs.back().count++;
+            else
+                runs.push_back({d, 1});
+        }
+        init(runs);
+    }
+
+    // Current degree of v, O(1) for vertices before the frontier or materialised, O(log runs) otherwise
+    deg_t operator [] (int v) const {
+        if (v < frontier)
+            return 0;
+        auto it = touched.find(v);
+        return it != touched.end() ? it->second.degree : initial_degree(v);
+    }
+
+    int size() const { return n; }
+    long degree_sum() const { return counts.degree_sum(); }
+
+    // The current degree sequence, O(n log runs)
+    vector<deg_t> degrees() const {
+        vector<deg_t> result;
+        result.reserve(n);
+        for (int v=0; v < n; ++v)
+            result.push_back((*this)[v]);
+        return result;
+    }
+
+    // The number of vertices with each current degree
+    const DegreeCounts &degree_counts() const { return counts; }
+
+    // Number of stored vertices, i.e. the materialised ones at or after the frontier
+    std::size_t materialised() const { return touched.size(); }
+
+    // The sampling engine has access to internals:
+
+    friend class ImplicitSimpleGraphs;
+
+private:
+
+    bool is_touched(int v) const { return touched.count(v) > 0; }
+
+    // The number of untouched vertices with degree d. Their current degree is their initial degree.
+    int untouched(deg_t d) const { return remaining[d] - touched_count[d]; }
+
+    Vertex &vertex(int v) {
+        auto it = touched.find(v);
+        Assert(it != touched.end());
+        return it->second;
+    }
+
+    // Materialise the untouched vertex v
+    Vertex &materialise(int v) {
+        Assert(v >= frontier && ! is_touched(v));
+        const deg_t d = initial_degree(v);
+        touched_count[d]++;
+        return touched[v] = Vertex{d, d, -1};
+    }
+
+    // Choose one of the untouched vertices of degree d uniformly. It is not materialised.
+    // Uses rejection, which takes remaining[d] / untouched(d) draws on average. The sampler keeps this
+    // at most two by materialising the whole class once half of it has been touched, see materialise_all().
+    template<typename RNG>
+    int random_untouched(deg_t d, RNG &rng) const {
+        Assert(untouched(d) > 0);
+
+        // The vertices of degree d at or after the frontier are those with rank total[d] - remaining[d] and up
+        std::uniform_int_distribution<int> dist(total[d] - remaining[d], total[d] - 1);
+        while (true) {
+            int v = vertex_of_rank(d, dist(rng));
+            if (! is_touched(v))
+                return v;
+        }
+    }
+
+    // True if more than half of the vertices of initial degree d at or after the frontier are materialised
+    bool mostly_touched(deg_t d) const { return 2*touched_count[d] > remaining[d]; }
+
+    // Materialise all untouched vertices of degree d, calling fun(v) for each, O(remaining[d] log runs)
+    template<typename Fun>
+    void materialise_all(deg_t d, Fun fun) {
+        for (int rank = total[d] - remaining[d]; rank < total[d]; ++rank) {
+            int v = vertex_of_rank(d, rank);
+            if (! is_touched(v)) {
+                materialise(v);
+                fun(v);
+            }
+        }
+    }
+
+    // Decrement the degree of the materialised vertex v
+    void decrement(int v) {
+        Vertex &vv = vertex(v);
+        counts.decrement(vv.degree);
+        vv.degree--;
+    }
+
+    // Move the frontier past v, which must have no stubs left
+    void advance(int v) {
+        Assert(v == frontier);
+        auto it = touched.find(v);
+        if (it != touched.end()) {
+            Assert(it->second.degree == 0);
+            touched_count[it->second.initial]--;
+            remaining[it->second.initial]--;
+            touched.erase(it);
+        } else {
+            Assert(initial_degree(v) == 0);
+            remaining[0]--;
+        }
+        frontier++;
+    }
+};
+
+} // namespace CDS
+
+#endif // CDS_IMPLICIT_DEGREE_SEQUENCE_H
@@ -0,0 +1,316 @@
+#ifndef CDS_IMPLICIT_SAMPLER_H
+#define CDS_IMPLICIT_SAMPLER_H
+
+#include "Common.h"
+#include "ImplicitDegreeSequence.h"
+#include "SamplerEngine.h"
+#include "EdgeSink.h"
+
+#include <vector>
+#include <random>
+#include <numeric>
+#include <type_traits>
+#include <tuple>
+#include <cmath>
+
+namespace CDS {
+
+// Simple graphs over an ImplicitDegreeSequence
+//
+// This is SimpleGraphs with all per-vertex state replaced by per-degree counts. The allowed set of each
+// step is determined by the degrees alone: a vertex is allowed if it is not excluded and its degree is at least
+// theta = min(wd, smallest degree in T), see SimpleGraphs. Thus the engine only needs, for each degree,
+// the number of non-excluded vertices, and the set T and the 'work' sequence can be kept as counts too.
+// Which vertices of the lowest degree class belong to T does not matter: when a vertex of that class is
+// chosen, T loses one member of that degree either way.
+//
+// A vertex is chosen by first choosing its degree, then a uniformly random non-excluded vertex of that degree,
+// which is either one of the materialised vertices or a newly materialised one. Each step has the same allowed
+// set and the same probabilities as with SimpleGraphs, thus the samples have the same distribution and logprob.
+// They are not identical for the same random stream.
+//
+// Each step takes O(log dmax) time with weights 1 or d, and O(dmax) with other weights, plus the
+// watershed computations, which are O(dmax) here. Only unconstrained sampling is supported.
+class ImplicitSimpleGraphs {
+    ImplicitDegreeSequence ds;
+    DegreeCounts work;       // ds with all but one stubs of the current vertex connected to 'top', and the current vertex removed
+
+    int current;             // the vertex being processed, -1 if none
+    vector<int> top_count;   // top_count[d]: the number of members of T with degree d
+    vector<deg_t> top_degrees; // the degrees of the members of T, decreasing, each listed once
+    vector<int> neighbours;  // vertices connected to the current vertex
+
+    deg_t wd;                // watershed degree of 'work'
+    bool wd_valid;
+
+    // Materialised non-excluded vertices of each degree. Together with the untouched vertices, these are the eligible ones.
+    vector<vector<int>> eligible;
+
+    // Number and degree sum of the non-excluded vertices in each degree class
+    FenwickTree<long> eligible_count, eligible_degree;
+
+    vector<double> class_weights; // workspace
+
+    int eligible_in_class(deg_t d) const { return eligible[d].size() + ds.untouched(d); }
+
+    void add_eligible(int v) {
+        auto &vv = ds.vertex(v);
+        if (vv.degree > 0) {
+            vv.slot = eligible[vv.degree].size();
+            eligible[vv.degree].push_back(v);
+        }
+    }
+
+    void remove_eligible(int v) {
+        auto &vv = ds.vertex(v);
+        if (vv.slot < 0)
+            return;
+        auto &list = eligible[vv.degree];
+        const int last = list.back();
+        list[vv.slot] = last;
+        ds.vertex(last).slot = vv.slot;
+        list.pop_back();
+        vv.slot = -1;
+    }
+
+    // Exclude the materialised vertex v
+    void block(int v) {
+        deg_t d = ds[v];
+        remove_eligible(v);
+        eligible_count.add(d, -1);
+        eligible_degree.add(d, -d);
+    }
+
+    void unblock(int v) {
+        deg_t d = ds[v];
+        add_eligible(v);
+        eligible_count.add(d, 1);
+        eligible_degree.add(d, d);
+    }
+
+    // Set up the state for connecting up 'vertex'
+    void begin_vertex(int vertex) {
+        current = vertex;
+        if (! ds.is_touched(vertex)) {
+            ds.materialise(vertex);
+            add_eligible(vertex);
+        }
+        block(vertex);
+
+        // T: the d-1 highest degree vertices other than 'vertex'
+        const DegreeCounts &counts = ds.degree_counts();
+        const deg_t dv = ds[vertex];
+        int needed = dv - 1;
+        for (deg_t d = counts.max_degree(); needed > 0; --d) {
+            int k = std::min(needed, counts.count(d) - (d == dv));
+            if (k > 0) {
+                Assert(d > 0);
+                top_count[d] = k;
+                top_degrees.push_back(d);
+                for (int i=0; i < k; ++i)
+                    work.decrement(d);
+                needed -= k;
+            }
+        }
+        for (deg_t d = dv; d > 0; --d)
+            work.decrement(d);
+
+        wd_valid = false;
+    }
+
+    // Remove exhausted degrees from the end of top_degrees, so that its last element is the lowest degree in T
+    void trim_top() {
+        while (! top_degrees.empty() && top_count[top_degrees.back()] == 0)
+            top_degrees.pop_back();
+    }
+
+    // The smallest degree that the current vertex may connect to
+    deg_t threshold() {
+        if (! wd_valid) {
+            wd = work.watershed();
+            wd_valid = true;
+        }
+
+        trim_top();
+
+        deg_t theta = top_degrees.empty() ? wd : std::min(wd, top_degrees.back());
+
+        // A watershed degree of 0 means that there is no restriction, but vertices without stubs are never allowed.
+        return std::max(theta, 1);
+    }
+
+    // Choose a non-excluded vertex of degree d uniformly, materialising it if necessary
+    template<typename RNG>
+    int choose_in_class(deg_t d, RNG &rng) {
+        Assert(eligible_count.prefix_sum(d) - eligible_count.prefix_sum(d-1) == eligible_in_class(d));
+
+        // Once most of the class is materialised, rejection would be slow: materialise the rest.
+        // This at most doubles the number of stored vertices.
+        if (ds.untouched(d) > 0 && ds.mostly_touched(d))
+            ds.materialise_all(d, [this] (int v) { add_eligible(v); });
+
+        const int materialised = eligible[d].size();
+
+        int i = std::uniform_int_distribution<int>(0, eligible_in_class(d) - 1)(rng);
+        if (i < materialised)
+            return eligible[d][i];
+
+        int v = ds.random_untouched(d, rng);
+        ds.materialise(v);
+        add_eligible(v);
+        return v;
+    }
+
+    // Choose a non-excluded vertex of degree at least 'theta', with probability proportional to
+    // its contribution to 'tree', in O(log dmax).
+    template<typename RNG>
+    int choose_from_tree(const FenwickTree<long> &tree, deg_t theta, RNG &rng, double &logprob) {
+        long below = tree.prefix_sum(theta - 1);
+        long tot = tree.total() - below;
+        Assert(tot > 0);
+
+        logprob -= std::log(tot);
+
+        deg_t d = tree.find(below + std::uniform_int_distribution<long>(0, tot-1)(rng));
+        return choose_in_class(d, rng);
+    }
+
+    template<typename RNG>
+    int choose_fast(deg_t theta, const StubWeight &, RNG &rng, double &logprob) {
+        return choose_from_tree(eligible_degree, theta, rng, logprob);
+    }
+
+    template<typename RNG>
+    int choose_fast(deg_t theta, const UniformWeight &, RNG &rng, double &logprob) {
+        return choose_from_tree(eligible_count, theta, rng, logprob);
+    }
+
+    // Other weights: choose the degree from the total weight of each degree class, O(dmax)
+    template<typename Weight, typename RNG>
+    int choose_fast(deg_t theta, const Weight &weight, RNG &rng, double &logprob) {
+        class_weights.clear();
+        for (deg_t d = theta; d < deg_t(eligible.size()); ++d)
+            class_weights.push_back(eligible_in_class(d) * double(weight(d)));
+
+        logprob -= std::log(std::accumulate(class_weights.begin(), class_weights.end(), 0.0));
+
+        std::discrete_distribution<> choose(class_weights.begin(), class_weights.end());
+        return choose_in_class(theta + choose(rng), rng);
+    }
+
+public:
+
+    explicit ImplicitSimpleGraphs(ImplicitDegreeSequence ds_) :
+        ds(std::move(ds_)),
+        work(ds.degree_counts()),
+        current(-1),
+        top_count(ds.total.size()),
+        wd(0), wd_valid(false),
+        eligible(ds.total.size())
+    {
+        if (! ds.degree_counts().is_graphical())
+            throw std::invalid_argument("The degree sequence is not graphical.");
+
+        vector<long> count(ds.total.size()), degree(ds.total.size());
+        for (deg_t d=0; d < deg_t(count.size()); ++d) {
+            count[d] = ds.total[d];
+            degree[d] = long(d) * ds.total[d];
+        }
+        eligible_count = FenwickTree<long>(count);
+        eligible_degree = FenwickTree<long>(degree);
+    }
+
+    const ImplicitDegreeSequence &degrees() const { return ds; }
+    int size() const { return ds.size(); }
+    long degree_sum() const { return ds.degree_sum(); }
+
+    // Choose a vertex that 'vertex' can connect to without breaking graphicality,
+    // and subtract the log of the total weight of the allowed vertices from 'logprob'.
+    template<typename Connectivity, typename Weight, typename RNG>
+    int choose(int vertex, const Connectivity &, const Weight &weight, RNG &rng, double &logprob) {
+        static_assert(std::is_same<Connectivity, Unconstrained>::value, "ImplicitSimpleGraphs supports unconstrained sampling only.");
+        static_assert(! is_context_weight<Weight>::value, "ImplicitSimpleGraphs chooses by degree class and does not take context weights.");
+
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        return choose_fast(threshold(), weight, rng, logprob);
+    }
+
+    // Connect 'vertex' to 'u'
+    void connect(int vertex, int u) {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        if (! ds.is_touched(u)) {
+            ds.materialise(u);
+            add_eligible(u);
+        }
+
+        neighbours.push_back(u);
+
+        const deg_t du = ds[u];
+        block(u);
+        ds.decrement(u);
+        ds.decrement(vertex);
+
+        // Update 'work'. If u is in T, or has the degree of its lowest member, it is unchanged.
+        if (top_count[du] > 0) {
+            top_count[du]--;
+        } else {
+            trim_top();
+            if (! top_degrees.empty()) {
+                deg_t dt = top_degrees.back();
+                top_count[dt]--;
+                work.increment(dt - 1);
+            }
+            work.decrement(du);
+            wd_valid = false;
+        }
+    }
+
+    // Called when 'vertex' has no more stubs left
+    void finish_vertex(int vertex, double &) {
+        if (vertex == current) {
+            for (const auto &v : neighbours)
+                unblock(v);
+            unblock(vertex);
+
+            for (const auto &d : top_degrees)
+                top_count[d] = 0;
+
+            neighbours.clear();
+            top_degrees.clear();
+            current = -1;
+        }
+
+        ds.advance(vertex);
+    }
+};
+
+
+// Sample simple graphs of an implicitly stored degree sequence, passing the edges to 'sink' as they are generated.
+// The samples have the same distribution and logprob as those of sample() for the same degrees.
+template<typename RNG, typename Sink>
+void sample_implicit(ImplicitDegreeSequence ds, double alpha, RNG &rng, Sink &sink) {
+    sample_dispatch<Unconstrained>(ImplicitSimpleGraphs(std::move(ds)), alpha, rng, sink);
+}
+
+// Sample simple graphs of an implicitly stored degree sequence, polling 'control' as edges are placed, see SampleControl.h.
+// Throws SamplingCancelled if 'control' cancels the sample.
+template<typename RNG, typename Sink, typename Control>
+void sample_implicit(ImplicitDegreeSequence ds, double alpha, RNG &rng, Sink &sink, Control &control) {
+    sample_dispatch<Unconstrained>(ImplicitSimpleGraphs(std::move(ds)), alpha, rng, sink, control);
+}
+
+// Sample simple graphs of an implicitly stored degree sequence
+template<typename RNG>
+std::tuple<edgelist_t, double> sample_implicit(ImplicitDegreeSequence ds, double alpha, RNG &rng) {
+    EdgeListSink sink;
+    sample_implicit(std::move(ds), alpha, rng, sink);
+    return sink.result();
+}
+
+} // namespace CDS
+
+#endif // CDS_IMPLICIT_SAMPLER_H
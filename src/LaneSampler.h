@@ -0,0 +1,246 @@
+#ifndef CDS_LANE_SAMPLER_H
+#define CDS_LANE_SAMPLER_H
+
+#include "Common.h"
+#include "DegreeSequence.h"
+#include "SamplerEngine.h"
+#include "SmallGraphs.h"
+
+#include <array>
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
+
+namespace CDS {
+
+// Samples many simple graphs with at most 64 vertices from the same degree sequence, 'Lanes' at a time.
+//
+// For such small graphs, the cost of sample() is dominated by setting up SimpleGraphs for each sample and by
+// the branches of its incremental bookkeeping. Here the state of each sample, called a lane, is a few fixed-size
+// arrays: the degrees, one 64-bit mask of the vertices of each degree, and a mask of the excluded vertices.
+// The arrays are stored with the lane index last, and each step adds one edge to every lane in turn,
+// so that the lanes' independent work interleaves and no memory is allocated after construction.
+//
+// The allowed set of each step is computed from the masks, as ReferenceSimpleGraphs does, except that the
+// watershed degree is kept while 'work' does not change, as with SimpleGraphs: the degree counts of 'work' are
+// popcounts, the watershed takes O(dmax), and a vertex is chosen by picking its degree class from the class
+// weights, then a set bit of the class mask, using a single random number. The samples have the same
+// distribution and logprob as those of sample(). They are not identical for the same random stream.
+//
+// All samples of a degree sequence have the same number of edges, thus all lanes finish together,
+// and are refilled with new samples as a batch.
+template<int Lanes = 8>
+class SmallGraphLanes {
+public:
+    static const int max_vertices = 64;
+
+private:
+    typedef std::uint64_t mask_t;
+
+    template<typename T>
+    using per_lane = std::array<T, Lanes>;
+
+    int n;
+    deg_t dmax;                  // largest degree of the sequence
+    long m;                      // number of edges of each sample
+    std::array<deg_t, max_vertices> initial;
+
+    std::array<per_lane<deg_t>, max_vertices> degree;     // degree[v][lane]
+    std::array<per_lane<mask_t>, max_vertices> by_degree; // by_degree[d][lane]: the vertices with degree d
+    per_lane<mask_t> excluded;   // the current vertex and its neighbours
+    per_lane<int> vertex;        // the current vertex
+    per_lane<double> logprob;
+
+    // The watershed degree of 'work' and the lowest degree in T, see threshold(). wd is -1 when it must be recomputed.
+    per_lane<deg_t> wd, top_degree;
+
+    vector<edge> edges;          // edge e of each lane is edges[e*Lanes + lane]
+
+    static mask_t bit(int v) { return mask_t(1) << v; }
+
+    // The smallest degree that the current vertex of 'lane' may connect to.
+    // Also sets top_degree[lane], and wd[lane] if it is not valid.
+    deg_t threshold(int lane) {
+        const int u = vertex[lane];
+        const deg_t du = degree[u][lane];
+        const mask_t eligible = ~excluded[lane];
+
+        // 'work': the current vertex removed, and its stubs but one connected to the du-1 highest degree
+        // non-excluded vertices, T. Any vertex with at least the lowest degree in T is allowed too.
+        std::array<int, max_vertices> count;
+        const bool compute_wd = wd[lane] < 0;
+        if (compute_wd) {
+            for (deg_t d=0; d <= dmax; ++d)
+                count[d] = popcount64(by_degree[d][lane]);
+            count[du]--;
+            count[0]++;
+        }
+
+        deg_t lowest_top = dmax + 1;
+        int needed = du - 1;
+        for (deg_t d = dmax; needed > 0; --d) {
+            int k = std::min(needed, popcount64(by_degree[d][lane] & eligible));
+            if (k > 0) {
+                Assert(d > 0);
+                if (compute_wd) {
+                    count[d] -= k;
+                    count[d-1] += k;
+                }
+                lowest_top = d;
+                needed -= k;
+            }
+        }
+        top_degree[lane] = lowest_top;
+
+        if (compute_wd)
+            wd[lane] = small_watershed(count, dmax, n);
+
+        deg_t theta = std::min(wd[lane], lowest_top);
+
+        // A watershed degree of 0 means that there is no restriction, but vertices without stubs are never allowed.
+        return std::max(theta, 1);
+    }
+
+    void reset(int lane) {
+        for (deg_t d=0; d <= dmax; ++d)
+            by_degree[d][lane] = 0;
+        for (int v=0; v < n; ++v) {
+            degree[v][lane] = initial[v];
+            by_degree[initial[v]][lane] |= bit(v);
+        }
+        vertex[lane] = 0;
+        excluded[lane] = bit(0);
+        logprob[lane] = 0;
+        wd[lane] = -1;
+    }
+
+    // Add the next edge of 'lane'
+    template<typename Weight, typename RNG>
+    void add_edge(int lane, long e, const Weight &weight, RNG &rng) {
+        typedef typename Weight::weight_type weight_type;
+
+        // Advance to the next vertex with stubs left
+        int u = vertex[lane];
+        while (degree[u][lane] == 0) {
+            u++;
+            excluded[lane] = bit(u);
+            wd[lane] = -1;
+        }
+        vertex[lane] = u;
+
+        const deg_t theta = threshold(lane);
+        const mask_t eligible = ~excluded[lane];
+
+        std::array<weight_type, max_vertices> class_weight;
+        weight_type total = 0;
+        deg_t last = theta; // the highest class with allowed vertices
+        for (deg_t d = theta; d <= dmax; ++d) {
+            class_weight[d] = weight(d) * popcount64(by_degree[d][lane] & eligible);
+            total += class_weight[d];
+            if (class_weight[d] > 0)
+                last = d;
+        }
+        Assert(total > 0);
+
+        logprob[lane] -= std::log(total);
+
+        // Choose the degree class, then a vertex of it uniformly, using the same random number
+        auto pick = random_below(total, rng);
+        deg_t d = theta;
+        while (d < last && pick >= class_weight[d])
+            pick -= class_weight[d++];
+
+        const mask_t candidates = by_degree[d][lane] & eligible;
+        const int k = std::min<int>(pick / weight(d), popcount64(candidates) - 1);
+        const int v = select_bit64(candidates, k);
+
+        weight.correct(logprob[lane], d);
+
+        // Connecting to a member of T leaves 'work' unchanged, as with SimpleGraphs. Within the lowest degree
+        // class of T, the vertices are interchangeable, so any vertex of degree at least top_degree counts as one.
+        if (d < top_degree[lane])
+            wd[lane] = -1;
+
+        // Connect u and v
+        by_degree[d][lane] ^= bit(v);
+        by_degree[d-1][lane] |= bit(v);
+        degree[v][lane]--;
+
+        const deg_t du = degree[u][lane];
+        by_degree[du][lane] ^= bit(u);
+        by_degree[du-1][lane] |= bit(u);
+        degree[u][lane]--;
+
+        excluded[lane] |= bit(v);
+        edges[e*Lanes + lane] = {u, v};
+    }
+
+public:
+
+    explicit SmallGraphLanes(const DegreeSequence &ds) :
+        n(ds.size()),
+        dmax(0),
+        m(0)
+    {
+        if (n > max_vertices)
+            throw std::invalid_argument("SmallGraphLanes supports at most 64 vertices.");
+
+        if (! ds.is_graphical())
+            throw std::invalid_argument("The degree sequence is not graphical.");
+
+        for (int v=0; v < n; ++v) {
+            initial[v] = ds[v];
+            dmax = std::max(dmax, ds[v]);
+            m += ds[v];
+        }
+        m /= 2;
+
+        edges.resize(m * Lanes);
+    }
+
+    int size() const { return n; }
+
+    // Generate 'count' samples, passing sample i to the sink returned by 'sink_for(i)'.
+    template<typename Weight, typename RNG, typename SinkFor>
+    void sample(long count, const Weight &weight, RNG &rng, SinkFor sink_for) {
+        static_assert(! is_context_weight<Weight>::value, "SmallGraphLanes chooses by degree class and does not take context weights.");
+
+        for (long first = 0; first < count; first += Lanes) {
+            const int active = std::min<long>(Lanes, count - first);
+
+            for (int lane=0; lane < active; ++lane)
+                reset(lane);
+
+            for (long e=0; e < m; ++e)
+                for (int lane=0; lane < active; ++lane)
+                    add_edge(lane, e, weight, rng);
+
+            for (int lane=0; lane < active; ++lane) {
+                auto sink = sink_for(first + lane);
+                for (long e=0; e < m; ++e)
+                    sink.edge(edges[e*Lanes + lane].first, edges[e*Lanes + lane].second);
+                sink.finish(logprob[lane]);
+            }
+        }
+    }
+};
+
+
+// Sample 'count' simple graphs of a degree sequence with at most 64 vertices, passing sample i to the sink
+// returned by 'sink_for(i)'. The samples have the same distribution and logprob as those of sample().
+template<int Lanes = 8, typename RNG, typename SinkFor>
+void sample_small(const DegreeSequence &ds, double alpha, long count, RNG &rng, SinkFor sink_for) {
+    SmallGraphLanes<Lanes> lanes(ds);
+    if (alpha == 1)
+        lanes.sample(count, StubWeight(), rng, sink_for);
+    else if (alpha == 0)
+        lanes.sample(count, UniformWeight(), rng, sink_for);
+    else
+        lanes.sample(count, PowerWeight(alpha), rng, sink_for);
+}
+
+} // namespace CDS
+
+#endif // CDS_LANE_SAMPLER_H
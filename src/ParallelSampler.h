@@ -0,0 +1,82 @@
+#ifndef CDS_PARALLEL_SAMPLER_H
+#define CDS_PARALLEL_SAMPLER_H
+
+#include "Common.h"
+#include "DegreeSequence.h"
+#include "DegreeSequenceMulti.h"
+#include "SamplerEngine.h"
+#include "SmallGraphs.h"
+#include "ThreadPool.h"
+
+namespace CDS {
+
+// Generate a single sample using all threads of 'pool'. This is meant for very large graphs:
+// the enumeration of the allowed vertices in each step is split across the threads, while small
+// steps stay on the calling thread. The result, including the logprob, is identical to that of
+// sample(), sample_conn(), sample_multi() and sample_conn_multi() for the same random state.
+//
+// Only the scans are parallel. Steps which do not need a scan, i.e. unconstrained simple graphs
+// with alpha = 1 or alpha = 0, are already O(log n) and gain nothing. Simple graphs with at most
+// 128 vertices use the fixed-size policies, as sample() does, and run on the calling thread.
+
+// Simple graphs, parallel version of sample()
+template<typename RNG, typename Sink, typename Control>
+void sample_parallel(DegreeSequence ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool, Control &control) {
+    with_simple_graphs<Unconstrained>(std::move(ds), [&] (auto graphs, auto connectivity) {
+        graphs.use_thread_pool(pool);
+        sample_dispatch<typename decltype(connectivity)::type>(std::move(graphs), alpha, rng, sink, control);
+    });
+}
+
+template<typename RNG, typename Sink>
+void sample_parallel(DegreeSequence ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool) {
+    NoControl control;
+    sample_parallel(std::move(ds), alpha, rng, sink, pool, control);
+}
+
+// Connected simple graphs, parallel version of sample_conn()
+template<typename RNG, typename Sink, typename Control>
+void sample_conn_parallel(DegreeSequence ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool, Control &control) {
+    with_simple_graphs<EquivClass>(std::move(ds), [&] (auto graphs, auto connectivity) {
+        graphs.use_thread_pool(pool);
+        sample_dispatch<typename decltype(connectivity)::type>(std::move(graphs), alpha, rng, sink, control);
+    });
+}
+
+template<typename RNG, typename Sink>
+void sample_conn_parallel(DegreeSequence ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool) {
+    NoControl control;
+    sample_conn_parallel(std::move(ds), alpha, rng, sink, pool, control);
+}
+
+// Loop-free multigraphs, parallel version of sample_multi()
+template<typename RNG, typename Sink, typename Control>
+void sample_multi_parallel(DegreeSequenceMulti ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool, Control &control) {
+    MultiGraphs graphs(std::move(ds));
+    graphs.use_thread_pool(pool);
+    sample_dispatch<Unconstrained>(std::move(graphs), alpha, rng, sink, control);
+}
+
+template<typename RNG, typename Sink>
+void sample_multi_parallel(DegreeSequenceMulti ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool) {
+    NoControl control;
+    sample_multi_parallel(std::move(ds), alpha, rng, sink, pool, control);
+}
+
+// Connected loop-free multigraphs, parallel version of sample_conn_multi()
+template<typename RNG, typename Sink, typename Control>
+void sample_conn_multi_parallel(DegreeSequenceMulti ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool, Control &control) {
+    MultiGraphs graphs(std::move(ds));
+    graphs.use_thread_pool(pool);
+    sample_dispatch<EquivClass>(std::move(graphs), alpha, rng, sink, control);
+}
+
+template<typename RNG, typename Sink>
+void sample_conn_multi_parallel(DegreeSequenceMulti ds, double alpha, RNG &rng, Sink &sink, ThreadPool &pool) {
+    NoControl control;
+    sample_conn_multi_parallel(std::move(ds), alpha, rng, sink, pool, control);
+}
+
+} // namespace CDS
+
+#endif // CDS_PARALLEL_SAMPLER_H
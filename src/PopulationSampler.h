@@ -0,0 +1,172 @@
+#ifndef CDS_POPULATION_SAMPLER_H
+#define CDS_POPULATION_SAMPLER_H
+
+#include "Common.h"
+#include "DegreeSequence.h"
+#include "DegreeSequenceMulti.h"
+#include "SamplerEngine.h"
+#include "SmallGraphs.h"
+#include "EdgeSink.h"
+#include "CounterRNG.h"
+#include "ThreadPool.h"
+#include "WeightStats.h"
+
+#include <vector>
+#include <tuple>
+#include <random>
+#include <cmath>
+#include <cstdint>
+
+namespace CDS {
+
+// Sequential importance resampling.
+//
+// A population of partial samples is advanced in lockstep, one vertex at a time.
+// After each vertex, if the effective sample size of the population has dropped below
+// 'threshold' times the population size, the population is resampled in proportion to the
+// importance weights exp(-logprob): partial samples with high weight are duplicated and those with
+// low weight are dropped. After resampling, all members carry the mean weight of the population
+// before resampling. Thus the final weights remain valid importance weights: as with plain
+// sampling, weighted averages over the returned samples are consistent estimates of
+// averages over the uniform distribution.
+//
+// Members of the population are advanced in parallel using 'pool'. Member k uses its own
+// counter-based random stream in each stage, thus the result does not depend on the number of threads.
+
+
+// A member of the population: the partial sample, its edges so far, and the weight correction from resampling
+template<typename C>
+struct PopulationMember {
+    C construction;
+    EdgeListSink edges;
+    double log_adjust;
+
+    double log_probability() const { return construction.log_probability() + log_adjust; }
+};
+
+template<typename Connectivity, typename Graphs, typename Weight, typename RNG>
+std::vector<std::tuple<edgelist_t, double>>
+population_engine(Graphs graphs, const Weight &weight, int size, RNG &rng, ThreadPool &pool, double threshold)
+{
+    typedef Construction<Connectivity, Graphs, Weight> C;
+    typedef PopulationMember<C> Member;
+
+    if (size < 1)
+        throw std::invalid_argument("The population size must be positive.");
+
+    const uint64_t key = std::uniform_int_distribution<uint64_t>()(rng);
+
+    const Member initial{C(std::move(graphs), weight), EdgeListSink(), 0.0};
+
+    std::vector<std::tuple<edgelist_t, double>> result;
+    result.reserve(size);
+
+    // Trees are sampled directly with uniform weights, no resampling is needed.
+    if (is_tree_case<Connectivity>(initial.construction.state())) {
+        for (int k=0; k < size; ++k) {
+            CounterRNG stream(key, k);
+            EdgeListSink sink;
+            sample_tree(initial.construction.state().degrees().degrees(), stream, sink);
+            result.push_back(sink.result());
+        }
+        return result;
+    }
+
+    std::vector<Member> population(size, initial);
+    std::vector<Member> next_population;
+    next_population.reserve(size);
+
+    std::uniform_real_distribution<double> uniform;
+
+    for (uint64_t stage=0; ! population[0].construction.finished(); ++stage) {
+        pool.parallel_for(size, [&] (long k) {
+            CounterRNG stream(key, stage*size + k);
+            population[k].construction.complete_vertex(stream, population[k].edges);
+        });
+
+        WeightStats stats;
+        for (const auto &member : population)
+            stats.add(member.log_probability());
+
+        if (stats.ess() >= threshold*size)
+            continue;
+
+        // Systematic resampling, using weights normalized to sum to 1
+        const double log_mean_weight = stats.log_weight_sum() - std::log(size);
+        const double step = 1.0 / size;
+        double target = uniform(rng) * step;
+        double cumulative = 0;
+
+        next_population.clear();
+        for (const auto &member : population) {
+            cumulative += std::exp(-member.log_probability() - stats.log_weight_sum());
+            while (target < cumulative && int(next_population.size()) < size) {
+                next_population.push_back(member);
+                next_population.back().log_adjust = -log_mean_weight - member.construction.log_probability();
+                target += step;
+            }
+        }
+        // Guard against the last member being missed due to rounding
+        while (int(next_population.size()) < size) {
+            next_population.push_back(population.back());
+            next_population.back().log_adjust = -log_mean_weight - population.back().construction.log_probability();
+        }
+
+        population.swap(next_population);
+    }
+
+    for (auto &member : population) {
+        member.edges.finish(member.log_probability());
+        result.push_back(member.edges.result());
+    }
+
+    return result;
+}
+
+template<typename Connectivity, typename Graphs, typename RNG>
+std::vector<std::tuple<edgelist_t, double>>
+population_dispatch(Graphs graphs, double alpha, int size, RNG &rng, ThreadPool &pool, double threshold) {
+    if (alpha == 1)
+        return population_engine<Connectivity>(std::move(graphs), StubWeight(), size, rng, pool, threshold);
+    else if (alpha == 0)
+        return population_engine<Connectivity>(std::move(graphs), UniformWeight(), size, rng, pool, threshold);
+    else
+        return population_engine<Connectivity>(std::move(graphs), PowerWeight(alpha), size, rng, pool, threshold);
+}
+
+
+// Sample a population of 'size' simple graphs
+template<typename RNG>
+std::vector<std::tuple<edgelist_t, double>>
+sample_population(DegreeSequence ds, double alpha, int size, RNG &rng, ThreadPool &pool, double threshold = 0.5) {
+    return with_simple_graphs<Unconstrained>(std::move(ds), [&] (auto graphs, auto connectivity) {
+        return population_dispatch<typename decltype(connectivity)::type>(std::move(graphs), alpha, size, rng, pool, threshold);
+    });
+}
+
+// Sample a population of 'size' connected simple graphs
+template<typename RNG>
+std::vector<std::tuple<edgelist_t, double>>
+sample_conn_population(DegreeSequence ds, double alpha, int size, RNG &rng, ThreadPool &pool, double threshold = 0.5) {
+    return with_simple_graphs<EquivClass>(std::move(ds), [&] (auto graphs, auto connectivity) {
+        return population_dispatch<typename decltype(connectivity)::type>(std::move(graphs), alpha, size, rng, pool, threshold);
+    });
+}
+
+// Sample a population of 'size' loop-free multigraphs
+template<typename RNG>
+std::vector<std::tuple<edgelist_t, double>>
+sample_multi_population(DegreeSequenceMulti ds, double alpha, int size, RNG &rng, ThreadPool &pool, double threshold = 0.5) {
+    return population_dispatch<Unconstrained>(MultiGraphs(std::move(ds)), alpha, size, rng, pool, threshold);
+}
+
+// Sample a population of 'size' connected loop-free multigraphs
+template<typename RNG>
+std::vector<std::tuple<edgelist_t, double>>
+sample_conn_multi_population(DegreeSequenceMulti ds, double alpha, int size, RNG &rng, ThreadPool &pool, double threshold = 0.5) {
+    return population_dispatch<EquivClass>(MultiGraphs(std::move(ds)), alpha, size, rng, pool, threshold);
+}
+
+} // namespace CDS
+
+#endif // CDS_POPULATION_SAMPLER_H
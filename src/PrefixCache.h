@@ -0,0 +1,229 @@
+#ifndef CDS_PREFIX_CACHE_H
+#define CDS_PREFIX_CACHE_H
+
+#include "Common.h"
+#include "SamplerEngine.h"
+#include "SmallGraphs.h"
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cmath>
+
+namespace CDS {
+
+// Repeated sampling from a single degree sequence, sharing work between samples.
+//
+// All samples start from the same state, which is validated and set up only once, then copied for each sample.
+// In addition, the first 'depth' levels of the decision tree are cached: for each state reached in the
+// first 'depth' edges, the allowed set and its cumulative weights (the selection table) are stored,
+// so that when another sample reaches the same state, the next edge is chosen with a binary search
+// instead of being recomputed. A state is identified by the set of edges created so far, thus choices
+// made in a different order lead to the same entry. Most of the benefit is at the first levels,
+// where the allowed sets are largest and the number of distinct states is smallest.
+//
+// The cache is bounded by the total size of the stored allowed sets, and the least recently used
+// states are evicted first. sample() may be called from multiple threads at the same time;
+// the stored entries are immutable, and only the index is protected by a mutex.
+//
+// The samples have exactly the same distribution and logprob as with sample_engine(), but they
+// are not identical for the same random stream.
+template<typename Connectivity, typename Graphs, typename Weight>
+class PrefixCache {
+
+    typedef Construction<Connectivity, Graphs, Weight> State;
+
+    // The choice of the next edge in a given state
+    struct Node {
+        vector<int> vertices;
+        vector<double> cumulative; // cumulative weights of 'vertices'
+        double log_total;          // log of the total weight
+
+        template<typename RNG>
+        int choose(RNG &rng) const {
+            double r = std::uniform_real_distribution<double>(0, cumulative.back())(rng);
+            auto it = std::upper_bound(cumulative.begin(), cumulative.end(), r);
+            if (it == cumulative.end()) // guard against rounding
+                --it;
+            return vertices[it - cumulative.begin()];
+        }
+    };
+
+    // A state is identified by the sorted list of its edges, each packed into a single integer.
+    typedef vector<uint64_t> Key;
+
+    struct KeyHash {
+        std::size_t operator () (const Key &key) const {
+            uint64_t h = 0xcbf29ce484222325;
+            for (const auto &e : key)
+                h = (h ^ e) * 0x100000001b3;
+            return h;
+        }
+    };
+
+    typedef std::list<std::pair<Key, std::shared_ptr<const Node>>> LRUList; // most recently used first
+
+    const State root;
+    const bool tree_case;
+    const int depth;
+    const std::size_t capacity;
+
+    mutable std::mutex mutex;
+    mutable LRUList lru;
+    mutable std::unordered_map<Key, typename LRUList::iterator, KeyHash> index;
+    mutable std::size_t stored;  // total number of vertices in the cached allowed sets
+
+    mutable std::atomic<long> hit_count, miss_count;
+
+    std::shared_ptr<const Node> lookup(const Key &key) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end())
+            return nullptr;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    void insert(const Key &key, std::shared_ptr<const Node> node) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.count(key) || node->vertices.size() > capacity)
+            return;
+
+        lru.emplace_front(key, node);
+        index[key] = lru.begin();
+        stored += node->vertices.size();
+
+        while (stored > capacity) {
+            stored -= lru.back().second->vertices.size();
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+
+    static std::shared_ptr<const Node> build(State &state) {
+        std::vector<typename Weight::weight_type> weights;
+        auto node = std::make_shared<Node>();
+        state.allowed_set(node->vertices, weights);
+        Assert(! node->vertices.empty());
+
+        node->cumulative.resize(weights.size());
+        double sum = 0;
+        for (std::size_t i=0; i < weights.size(); ++i)
+            node->cumulative[i] = sum += weights[i];
+        node->log_total = std::log(std::accumulate(weights.begin(), weights.end(), 0.0));
+        return node;
+    }
+
+    static uint64_t pack(int u, int v) { return (uint64_t(u) << 32) | uint32_t(v); }
+
+public:
+
+    // 'depth': the number of edges for which the choices are cached; 'capacity': the maximum total size of the cached allowed sets.
+    // Throws std::invalid_argument if the degree sequence cannot be sampled, like the samplers.
+    PrefixCache(Graphs graphs, const Weight &weight, int depth, std::size_t capacity = std::size_t(1) << 22) :
+        root(std::move(graphs), weight),
+        tree_case(is_tree_case<Connectivity>(root.state())),
+        depth(depth),
+        capacity(capacity),
+        stored(0),
+        hit_count(0), miss_count(0)
+    { }
+
+    PrefixCache(const PrefixCache &) = delete;
+    PrefixCache & operator = (const PrefixCache &) = delete;
+
+    // Generate a sample, passing the edges to 'sink' as they are generated. Thread-safe.
+    template<typename RNG, typename Sink>
+    void sample(RNG &rng, Sink &sink) const {
+        if (tree_case)
+            return sample_tree(root.state().degrees().degrees(), rng, sink);
+
+        State state(root);
+        Key key;
+
+        while (! state.finished()) {
+            if (int(key.size()) < depth && state.edge_next()) {
+                auto node = lookup(key);
+                if (node) {
+                    hit_count++;
+                } else {
+                    miss_count++;
+                    node = build(state);
+                    insert(key, node);
+                }
+
+                int u = node->choose(rng);
+                const int v = state.current_vertex();
+                state.add_edge(u, node->log_total, sink);
+
+                // Keep the key sorted
+                uint64_t e = pack(v, u);
+                key.insert(std::upper_bound(key.begin(), key.end(), e), e);
+            } else {
+                state.step(rng, sink);
+            }
+        }
+
+        sink.finish(state.log_probability());
+    }
+
+    // Number of cache hits and misses so far
+    long hits() const { return hit_count; }
+    long misses() const { return miss_count; }
+
+    // Number of cached states
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return index.size();
+    }
+};
+
+
+// Create a PrefixCache with the weight policy for 'alpha', as in sample_dispatch(), and pass it to 'fun'.
+// Returns the result of 'fun'.
+template<typename Connectivity, typename Graphs, typename Fun>
+auto prefix_cache_dispatch(Graphs graphs, double alpha, int depth, std::size_t capacity, Fun fun) {
+    if (alpha == 1) {
+        PrefixCache<Connectivity, Graphs, StubWeight> cache(std::move(graphs), StubWeight(), depth, capacity);
+        return fun(cache);
+    } else if (alpha == 0) {
+        PrefixCache<Connectivity, Graphs, UniformWeight> cache(std::move(graphs), UniformWeight(), depth, capacity);
+        return fun(cache);
+    } else {
+        PrefixCache<Connectivity, Graphs, PowerWeight> cache(std::move(graphs), PowerWeight(alpha), depth, capacity);
+        return fun(cache);
+    }
+}
+
+// Create a PrefixCache for simple graphs, connected if 'connected' is set, and pass it to 'fun'. Returns the result of 'fun'.
+// Sequences of at most 128 vertices use the fixed-size policies of SmallGraphs.h.
+template<typename Fun>
+auto with_prefix_cache(DegreeSequence ds, bool connected, double alpha, int depth, std::size_t capacity, Fun fun) {
+    auto make_cache = [&] (auto graphs, auto connectivity) {
+        return prefix_cache_dispatch<typename decltype(connectivity)::type>(std::move(graphs), alpha, depth, capacity, fun);
+    };
+    if (connected)
+        return with_simple_graphs<EquivClass>(std::move(ds), make_cache);
+    else
+        return with_simple_graphs<Unconstrained>(std::move(ds), make_cache);
+}
+
+// Create a PrefixCache for loop-free multigraphs, connected if 'connected' is set, and pass it to 'fun'. Returns the result of 'fun'.
+template<typename Fun>
+auto with_prefix_cache(DegreeSequenceMulti ds, bool connected, double alpha, int depth, std::size_t capacity, Fun fun) {
+    if (connected)
+        return prefix_cache_dispatch<EquivClass>(MultiGraphs(std::move(ds)), alpha, depth, capacity, fun);
+    else
+        return prefix_cache_dispatch<Unconstrained>(MultiGraphs(std::move(ds)), alpha, depth, capacity, fun);
+}
+
+} // namespace CDS
+
+#endif // CDS_PREFIX_CACHE_H
@@ -0,0 +1,142 @@
+#ifndef CDS_REFERENCE_GRAPHS_H
+#define CDS_REFERENCE_GRAPHS_H
+
+#include "Common.h"
+#include "DegreeSequence.h"
+#include "SamplerEngine.h"
+
+namespace CDS {
+
+// Reference graph type policy for simple graphs.
+//
+// This is the direct implementation of the allowed set: for each stub, all but one stubs of the
+// current vertex are temporarily connected to the highest-degree non-excluded vertices, and the
+// watershed degree of the result is computed from scratch. It takes O(n) time per stub.
+// SimpleGraphs maintains the same allowed set incrementally. This class is kept so that optimized
+// engines can be validated against it, see cdvalidate.
+class ReferenceSimpleGraphs {
+    DegreeSequence ds;
+    DegreeSequence work;    // Workspace for allowed_set(), kept to avoid reallocating it on each step
+    ExclusionSet exclusion; // If exclusion[v] == true, the current vertex may not connect to v
+
+    AllowedList allowed;
+
+    // Call visit(v) for each vertex v that 'vertex' can connect to without breaking graphicality, from the highest
+    // degree down, and return the threshold of SimpleGraphs: the smallest of the watershed degree and the degrees in T.
+    template<typename Visit>
+    deg_t enumerate_allowed(int vertex, Visit visit) {
+        // Temporarily connect all but one stub of 'vertex' to highest-degree
+        // non-excluded vertices, T. All of these are allowed connections.
+        work = ds;
+
+        int d = ds[vertex];
+        deg_t lowest_top = 0; // the lowest degree in T, if T is not empty
+
+        int i=ds.n-1;
+        while (d > 1) {
+            int v = ds.sorted_verts[i--];
+            Assert(work[v] > 0);
+            if (v != vertex && ! exclusion[v]) {
+                work.connect(vertex, v);
+                visit(v);
+                lowest_top = ds[v];
+                d--;
+            }
+        }
+
+        // Remove the final stub of 'vertex'.
+        work.decrement(vertex);
+
+        // Find watershed degree.
+        int wd = work.watershed();
+
+        // Of the rest of the vertices, determine if a connection is allowed
+        // based on the watershed degree.
+        for (; i >= 0; --i) {
+            int v = ds.sorted_verts[i];
+
+            if (ds[v] >= wd) {
+                if (v != vertex && ! exclusion[v])
+                    visit(v);
+            } else {
+                break;
+            }
+        }
+
+        return std::max(ds[vertex] > 1 ? std::min(wd, lowest_top) : wd, 1);
+    }
+
+public:
+
+    explicit ReferenceSimpleGraphs(DegreeSequence ds_) :
+        ds(std::move(ds_)),
+        exclusion(ds.n)
+    {
+        if (! ds.is_graphical())
+            throw std::invalid_argument("The degree sequence is not graphical.");
+    }
+
+    const DegreeSequence &degrees() const { return ds; }
+    int size() const { return ds.n; }
+    int degree_sum() const { return ds.dsum; }
+
+    // Determine the vertices that 'vertex' can connect to without breaking graphicality / connectedness,
+    // along with their weights.
+    template<typename Connectivity, typename Weight>
+    void allowed_set(int vertex, const Connectivity &conn, const Weight &weight,
+                     vector<int> &allowed, vector<typename Weight::weight_type> &weights)
+    {
+        const size_t first = allowed.size();
+        const deg_t theta = enumerate_allowed(vertex, [&] (int v) {
+            if ( conn.connectable(vertex, v) )
+                allowed.push_back(v);
+        });
+
+        const WeightContext<Connectivity> context{conn, vertex, theta};
+        for (size_t j = first; j < allowed.size(); ++j)
+            weights.push_back(candidate_weight(weight, context, allowed[j], ds[allowed[j]]));
+    }
+
+    // The smallest number of free stubs of a vertex that 'vertex' may connect to in its next step
+    deg_t step_threshold(int vertex) {
+        return enumerate_allowed(vertex, [] (int) { });
+    }
+
+    template<typename Connectivity, typename Weight, typename RNG>
+    int choose(int vertex, const Connectivity &conn, const Weight &weight, RNG &rng, double &logprob) {
+        auto &weights = allowed.weights(typename Weight::weight_type());
+        allowed.vertices.clear();
+        weights.clear();
+
+        allowed_set(vertex, conn, weight, allowed.vertices, weights);
+
+        return allowed.choose(weights, rng, logprob);
+    }
+
+    void connect(int vertex, int u) {
+        exclusion.insert(u);
+        ds.connect(u, vertex);
+    }
+
+    // Called when 'vertex' has no more stubs left
+    void finish_vertex(int, double &) {
+        exclusion.clear();
+    }
+};
+
+
+// Sample simple graphs using the reference policy
+template<typename RNG, typename Sink>
+void sample_reference(DegreeSequence ds, double alpha, RNG &rng, Sink &sink) {
+    sample_dispatch<Unconstrained>(ReferenceSimpleGraphs(std::move(ds)), alpha, rng, sink);
+}
+
+// Sample connected simple graphs using the reference policy
+template<typename RNG, typename Sink>
+void sample_conn_reference(DegreeSequence ds, double alpha, RNG &rng, Sink &sink) {
+    sample_dispatch<EquivClass>(ReferenceSimpleGraphs(std::move(ds)), alpha, rng, sink);
+}
+
+} // namespace CDS
+
+#endif // CDS_REFERENCE_GRAPHS_H
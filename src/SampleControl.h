@@ -0,0 +1,80 @@
+#ifndef CDS_SAMPLE_CONTROL_H
+#define CDS_SAMPLE_CONTROL_H
+
+#include <chrono>
+#include <stdexcept>
+
+namespace CDS {
+
+// Generating a single sample of a large degree sequence may take a long time. The samplers accept
+// an optional control object, which is polled as edges are placed. It can report progress, and it can
+// cancel the sample, in which case the sampler throws SamplingCancelled and the sink receives no finish().
+//
+// A control object is any object with the following member functions:
+//
+//   void start();                        // called once when the sample is started
+//   void poll(long edges, int vertices); // called after each step with the number of edges placed
+//                                        // and the number of vertices whose stubs are all connected
+//
+// poll() is called very frequently, thus it must be cheap. SampleControl takes care of this.
+
+
+// Progress of the sample under construction
+struct Progress {
+    long edges;     // number of edges placed so far
+    int vertices;   // number of vertices whose stubs are all connected
+    double elapsed; // seconds since the sample was started
+};
+
+// Thrown by the samplers when the control object requests cancellation
+class SamplingCancelled : public std::runtime_error {
+public:
+    SamplingCancelled() : std::runtime_error("Sampling was cancelled.") { }
+};
+
+// Control object which does nothing. Used when no control is given; the calls are optimized away.
+struct NoControl {
+    void start() { }
+    void poll(long, int) { }
+};
+
+// Calls 'hook(progress)' every 'interval' edges. If it returns true, the sample is cancelled.
+// 'hook' can be any callable taking a const Progress &, e.g. one checking a flag set by a signal handler.
+template<typename Hook>
+class SampleControl {
+    using clock = std::chrono::steady_clock;
+
+    Hook hook;
+    long interval;
+    long next_poll;
+    clock::time_point start_time;
+
+public:
+
+    explicit SampleControl(Hook hook, long interval = 1 << 10) :
+        hook(std::move(hook)), interval(interval > 0 ? interval : 1), next_poll(interval)
+    { }
+
+    void start() {
+        start_time = clock::now();
+        next_poll = interval;
+    }
+
+    void poll(long edges, int vertices) {
+        if (edges >= next_poll) {
+            next_poll = edges + interval;
+            Progress progress{edges, vertices, std::chrono::duration<double>(clock::now() - start_time).count()};
+            if (hook(progress))
+                throw SamplingCancelled();
+        }
+    }
+};
+
+template<typename Hook>
+SampleControl<Hook> make_sample_control(Hook hook, long interval = 1 << 10) {
+    return SampleControl<Hook>(std::move(hook), interval);
+}
+
+} // namespace CDS
+
+#endif // CDS_SAMPLE_CONTROL_H
@@ -0,0 +1,915 @@
+#ifndef CDS_SAMPLER_ENGINE_H
+#define CDS_SAMPLER_ENGINE_H
+
+#include "Common.h"
+#include "DegreeSequence.h"
+#include "DegreeSequenceMulti.h"
+#include "EquivClass.h"
+#include "TreeSampler.h"
+#include "EdgeSink.h"
+#include "SampleControl.h"
+#include "FenwickTree.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <stdexcept>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+#include <memory>
+#include <cmath>
+
+namespace CDS {
+
+// The sampling engine is parameterized by three policies:
+//
+//  - The graph type policy (SimpleGraphs, MultiGraphs) holds the degree sequence,
+//    chooses among the allowed connections and updates the state after a connection.
+//  - The connectivity policy (Unconstrained, EquivClass) decides which connections preserve
+//    potential connectedness.
+//  - The weight policy (StubWeight, UniformWeight, PowerWeight, or one of the context weights
+//    ResidualWeight, ComponentWeight, SlackWeight) determines the weight with which each allowed vertex is chosen.
+
+
+/***** Weight policies *****/
+
+// Weight d^alpha for general alpha
+class PowerWeight {
+    double alpha;
+
+public:
+    typedef double weight_type;
+
+    explicit PowerWeight(double alpha) : alpha(alpha) { }
+
+    weight_type operator () (deg_t d) const { return std::pow(d, alpha); }
+
+    // Convert the probability of choosing a vertex to the probability of choosing one of its stubs
+    void correct(double &logprob, deg_t d) const { logprob += (alpha - 1) * std::log(d); }
+};
+
+// Weight d, i.e. alpha = 1. This is equivalent to choosing stubs uniformly.
+class StubWeight {
+public:
+    typedef deg_t weight_type;
+
+    weight_type operator () (deg_t d) const { return d; }
+
+    void correct(double &, deg_t) const { }
+};
+
+// Weight 1 for vertices with free stubs, i.e. alpha = 0.
+class UniformWeight {
+public:
+    typedef deg_t weight_type;
+
+    weight_type operator () (deg_t d) const { return d > 0; }
+
+    void correct(double &logprob, deg_t d) const { logprob -= std::log(d); }
+};
+
+
+/***** Context weight policies *****/
+
+// The weights above depend only on the number of free stubs d of a candidate, which lets the graph type policies
+// choose by degree class. A context weight may also depend on the state of the step: the current vertex, the smallest
+// degree allowed in the step and the connectivity tracker, given as a WeightContext. It derives from ContextWeight and provides
+//
+//     weight_type operator () (const WeightContext<C> &context, int v, deg_t d) const;
+//     void correct(double &logprob, const WeightContext<C> &context, int v, deg_t d) const;
+//
+// where correct() adds log(weight / d), as for the other weights. Construction calls correct() before the connection is
+// made, i.e. with the same state that the choice saw, thus the logprob is exact for any positive weight. The weight
+// must not depend on the order in which the edges were placed, since PrefixCache shares the choices of equal states.
+// SimpleGraphs, MultiGraphs and SmallSimpleGraphs use a scan of the allowed vertices for context weights.
+// ImplicitSimpleGraphs and SmallGraphLanes, which only ever choose by degree class, do not take them.
+
+struct ContextWeight { };
+
+template<typename Weight>
+struct is_context_weight : std::is_base_of<ContextWeight, Weight> { };
+
+// The state of a step, as seen by a context weight
+template<typename Connectivity>
+struct WeightContext {
+    const Connectivity &conn;
+    int vertex;     // the vertex being connected up
+    deg_t theta;    // the smallest number of free stubs that a candidate may have in this step
+};
+
+// The weight of candidate v, which has d free stubs, under any weight policy
+template<typename Weight, typename Context>
+typename Weight::weight_type candidate_weight(const Weight &weight, const Context &, int, deg_t d, std::false_type) {
+    return weight(d);
+}
+
+template<typename Weight, typename Context>
+typename Weight::weight_type candidate_weight(const Weight &weight, const Context &context, int v, deg_t d, std::true_type) {
+    return weight(context, v, d);
+}
+
+template<typename Weight, typename Context>
+typename Weight::weight_type candidate_weight(const Weight &weight, const Context &context, int v, deg_t d) {
+    return candidate_weight(weight, context, v, d, is_context_weight<Weight>());
+}
+
+// Weight d exp(-d0(u) d0(v) / 4m), where u is the current vertex, d0 are the initial degrees and m is the number of edges.
+// This is the exponential form of the weight (1 - d0(u) d0(v) / 4m) with which Bayati, Kim and Saberi (Algorithmica 58,
+// 860, 2010) pair stubs: it compensates for pairs of high degree vertices being connected more often by stub matching
+// than in a uniform simple graph, which makes their sequential algorithm asymptotically uniform for sparse sequences.
+class ResidualWeight : public ContextWeight {
+    std::shared_ptr<const vector<deg_t>> initial; // shared by the copies held by a population
+    double scale;                                 // 1 / 4m
+
+public:
+    typedef double weight_type;
+
+    // 'ds' gives the initial degrees
+    template<typename Container>
+    explicit ResidualWeight(const Container &ds) {
+        auto degrees = std::make_shared<vector<deg_t>>(ds.size());
+        long dsum = 0;
+        for (int v=0; v < int(ds.size()); ++v) {
+            (*degrees)[v] = ds[v];
+            dsum += ds[v];
+        }
+        initial = std::move(degrees);
+        scale = dsum > 0 ? 1.0 / (2.0*dsum) : 0;
+    }
+
+    template<typename Context>
+    weight_type operator () (const Context &context, int v, deg_t d) const {
+        return d * std::exp(-exponent(context.vertex, v));
+    }
+
+    template<typename Context>
+    void correct(double &logprob, const Context &context, int v, deg_t) const { logprob -= exponent(context.vertex, v); }
+
+private:
+    double exponent(int u, int v) const { return scale * (*initial)[u] * (*initial)[v]; }
+};
+
+// Weight d c^beta, where c is the number of free stubs of the candidate's component, see EquivClass::component_stubs().
+// With beta < 0, the stubs of components with few free stubs are preferred, with beta > 0 those of large ones.
+// Without a connectivity constraint, components are not tracked and c = 1, thus this is the same as StubWeight.
+class ComponentWeight : public ContextWeight {
+    double beta;
+
+public:
+    typedef double weight_type;
+
+    explicit ComponentWeight(double beta) : beta(beta) { }
+
+    template<typename Context>
+    weight_type operator () (const Context &context, int v, deg_t d) const {
+        return d > 0 ? d * std::pow(context.conn.component_stubs(v), beta) : 0;
+    }
+
+    template<typename Context>
+    void correct(double &logprob, const Context &context, int v, deg_t) const {
+        logprob += beta * std::log(context.conn.component_stubs(v));
+    }
+};
+
+// Weight d (d - theta + 1)^beta, where theta is the smallest degree allowed in the step. The candidates just above
+// the watershed threshold have the least slack: with beta > 0, those well above it are preferred, with beta < 0 the others.
+// Without a threshold, theta = 1, and this is the same as PowerWeight(1 + beta).
+class SlackWeight : public ContextWeight {
+    double beta;
+
+public:
+    typedef double weight_type;
+
+    explicit SlackWeight(double beta) : beta(beta) { }
+
+    template<typename Context>
+    weight_type operator () (const Context &context, int, deg_t d) const {
+        return d > 0 ? d * std::pow(d - context.theta + 1, beta) : 0;
+    }
+
+    template<typename Context>
+    void correct(double &logprob, const Context &context, int, deg_t d) const {
+        logprob += beta * std::log(d - context.theta + 1);
+    }
+};
+
+
+/***** Connectivity policies *****/
+
+// No connectivity constraint. Has the same interface as EquivClass.
+class Unconstrained {
+public:
+    template<typename Container>
+    explicit Unconstrained(const Container &) { }
+
+    bool is_potentially_connected() const { return true; }
+    bool connectable(int, int) const { return true; }
+    bool connectable_to_all(int) const { return true; }
+    void connect(int, int) { }
+
+    // Components are not tracked: every vertex counts as a component with a single free stub
+    deg_t component_stubs(int) const { return 1; }
+
+    struct ConnectableFrom {
+        bool all() const { return true; }
+        bool operator () (int) const { return true; }
+    };
+
+    ConnectableFrom connectable_from(int) const { return ConnectableFrom(); }
+};
+
+// Call fun(connectable) with the connectability test of 'vertex', see EquivClass::connectable_from().
+// When 'vertex' may connect to any vertex, e.g. once all vertices are in a single component, the test of
+// Unconstrained is passed instead, so that the scan is compiled without any per-candidate check.
+template<typename Connectivity, typename Fun>
+void with_connectable_from(const Connectivity &conn, int vertex, Fun fun) {
+    auto connectable = conn.connectable_from(vertex);
+    if (connectable.all())
+        fun(Unconstrained::ConnectableFrom());
+    else
+        fun(connectable);
+}
+
+
+/***** Graph type policies *****/
+
+// Workspace for choosing among an explicit list of allowed vertices.
+// The weights are stored in the weight policy's own type, so that integer weights
+// are summed without any floating point work.
+class AllowedList {
+    vector<deg_t> int_weights;
+    vector<double> real_weights;
+
+public:
+    vector<int> vertices;
+
+    vector<deg_t> &weights(deg_t) { return int_weights; }
+    vector<double> &weights(double) { return real_weights; }
+
+    // Choose one of 'vertices' with probability proportional to 'w',
+    // and subtract the log of the total weight from 'logprob'.
+    template<typename W, typename RNG>
+    int choose(const vector<W> &w, RNG &rng, double &logprob) const {
+        Assert(! vertices.empty());
+
+        double tot = std::accumulate(w.begin(), w.end(), 0.0);
+        logprob -= std::log(tot);
+
+        std::discrete_distribution<> choose(w.begin(), w.end());
+
+        return vertices[choose(rng)];
+    }
+};
+
+// Splits the enumeration of the allowed vertices of a step across a thread pool.
+// The candidate range is cut into chunks, each chunk is scanned into its own buffer, and the buffers
+// are concatenated in order. Thus the list is identical to that of a serial scan, and so is the choice made from it.
+// Ranges below 'threshold' are scanned serially, as waking up the workers costs more than it saves.
+// Without a pool, all scans are serial.
+class ParallelScan {
+    struct Chunk {
+        vector<int> vertices;
+        vector<deg_t> int_weights;
+        vector<double> real_weights;
+
+        vector<deg_t> &weights(deg_t) { return int_weights; }
+        vector<double> &weights(double) { return real_weights; }
+    };
+
+    ThreadPool *pool;
+    long threshold;
+    mutable vector<Chunk> chunks; // workspace
+
+public:
+
+    ParallelScan() : pool(nullptr), threshold(0) { }
+
+    void set_pool(ThreadPool *pool_, long threshold_) {
+        pool = pool_;
+        threshold = threshold_;
+    }
+
+    bool parallel(long range) const { return pool && pool->size() > 1 && range >= threshold; }
+
+    // Call scan(begin, end, vertices, weights) on consecutive chunks [begin, end) of [0, range) in parallel,
+    // and append the vertices and weights found to the given lists, in chunk order.
+    template<typename W, typename Scan>
+    void run(long range, Scan scan, vector<int> &vertices, vector<W> &weights) const {
+        // A range of 'threshold' gets 4 chunks, larger ranges up to 4 per thread for load balancing.
+        const long count = std::min<long>(4 * pool->size(), 4 * range / std::max(threshold, 1L));
+        if (long(chunks.size()) < count)
+            chunks.resize(count);
+
+        pool->parallel_for(count, [&] (long k) {
+            auto &chunk = chunks[k];
+            auto &w = chunk.weights(W());
+            chunk.vertices.clear();
+            w.clear();
+            scan(range * k / count, range * (k+1) / count, chunk.vertices, w);
+        });
+
+        for (long k=0; k < count; ++k) {
+            auto &w = chunks[k].weights(W());
+            vertices.insert(vertices.end(), chunks[k].vertices.begin(), chunks[k].vertices.end());
+            weights.insert(weights.end(), w.begin(), w.end());
+        }
+    }
+};
+
+
+// Simple graphs
+//
+// The stubs of the current vertex x are connected one at a time. A vertex v may be chosen
+// if it is not excluded (already connected to x), and either it is among the d-1 highest-degree
+// non-excluded vertices (the set T), or its degree is at least the watershed degree wd of the sequence
+// obtained by connecting all but one stub of x to T, then removing the last stub of x.
+// Since T consists of the highest degrees, this means that v may be chosen if its degree is at least
+// theta = min(wd, smallest degree in T).
+//
+// Rather than recomputing all of this for each stub, it is maintained incrementally:
+//
+//  - 'work' holds the degree sequence with the stubs of x connected to T, and x removed. When the chosen
+//    vertex u is in T, this sequence does not change; otherwise the lowest member of T is replaced by u,
+//    which takes two O(1) updates. The watershed is only recomputed when 'work' changes.
+//  - Excluded vertices and x itself are kept at the top of their degree class in ds.sorted_verts,
+//    so that the non-excluded vertices of each degree class occupy a contiguous range.
+//  - Fenwick trees over the degree classes hold the number of non-excluded vertices of each degree
+//    and their degree sum. With these, a vertex can be chosen in O(log n) with weights 1 or d.
+//    Other weights, and connectivity constraints that do not allow all vertices, use a scan of the allowed vertices.
+//
+// Thus processing a vertex of degree d takes O(d log n) time, plus the cost of the watershed computations,
+// instead of O(d n). The scans can be split across a thread pool, see use_thread_pool().
+class SimpleGraphs {
+    DegreeSequence ds;
+    DegreeSequence work;     // ds with all but one stubs of the current vertex connected to 'top', and the current vertex removed
+
+    int current;             // the vertex being processed, -1 if none
+    ExclusionSet top;        // T: the vertices of 'top_list' which have not been chosen yet
+    vector<int> top_list;    // members of T in order of non-increasing degree
+    vector<int> neighbours;  // vertices connected to the current vertex
+
+    deg_t wd;                // watershed degree of 'work'
+    bool wd_valid;
+
+    vertex_vector<int> blocked; // blocked[d]: the number of excluded vertices at the top of degree class d in ds.sorted_verts
+
+    // Number and degree sum of the non-excluded vertices in each degree class
+    FenwickTree<long> eligible_count, eligible_degree;
+
+    AllowedList allowed;
+    ParallelScan scan;
+
+    int class_begin(deg_t d) const { return ds.counts[d].accum - ds.counts[d].count; }
+    int class_end(deg_t d) const { return ds.counts[d].accum - blocked[d]; } // end of the non-excluded part
+
+    // Swap the vertices at positions i and j of ds.sorted_verts. They must have the same degree.
+    void swap_positions(int i, int j) {
+        int u = ds.sorted_verts[i], v = ds.sorted_verts[j];
+        Assert(ds[u] == ds[v]);
+        ds.sorted_verts[i] = v;
+        ds.sorted_verts[j] = u;
+        ds.verts[u].sorted_index = j;
+        ds.verts[v].sorted_index = i;
+    }
+
+    // Exclude v: move it to the top part of its degree class
+    void block(int v) {
+        deg_t d = ds[v];
+        swap_positions(ds.verts[v].sorted_index, class_end(d) - 1);
+        blocked[d]++;
+        eligible_count.add(d, -1);
+        eligible_degree.add(d, -d);
+    }
+
+    // Decrement the degree of an excluded vertex, keeping the excluded part of each degree class at the top
+    void decrement_blocked(int v) {
+        deg_t d = ds[v];
+        // DegreeSequence::decrement() moves the vertex from the lowest position of the class,
+        // so first move v to the lowest position of the excluded part.
+        swap_positions(ds.verts[v].sorted_index, class_end(d));
+        blocked[d]--;
+        ds.decrement(v);
+        blocked[d-1]++; // v is now at the highest position of class d-1
+    }
+
+    void unblock(int v) {
+        deg_t d = ds[v];
+        blocked[d] = 0;
+        eligible_count.add(d, 1);
+        eligible_degree.add(d, d);
+    }
+
+    // Set up the state for connecting up 'vertex'
+    void begin_vertex(int vertex) {
+        current = vertex;
+        block(vertex);
+
+        // T: the d-1 highest degree vertices other than 'vertex'
+        top_list.clear();
+        for (int i=ds.n-1, d=ds[vertex]; d > 1; --i) {
+            int v = ds.sorted_verts[i];
+            if (v != vertex) {
+                Assert(work[v] > 0);
+                top_list.push_back(v);
+                top.insert(v);
+                work.decrement(v);
+                d--;
+            }
+        }
+        while (work[vertex] > 0)
+            work.decrement(vertex);
+
+        wd_valid = false;
+    }
+
+    // Remove chosen vertices from the end of top_list, so that its last element is the lowest member of T
+    void trim_top() {
+        while (! top_list.empty() && ! top[top_list.back()])
+            top_list.pop_back();
+    }
+
+    // The smallest degree that the current vertex may connect to
+    deg_t threshold() {
+        if (! wd_valid) {
+            wd = work.watershed();
+            wd_valid = true;
+        }
+
+        trim_top();
+
+        deg_t theta = top_list.empty() ? wd : std::min(wd, ds[top_list.back()]);
+
+        // A watershed degree of 0 means that there is no restriction, but vertices without stubs are never allowed.
+        return std::max(theta, 1);
+    }
+
+    // Choose a non-excluded vertex of degree at least 'theta', with probability proportional to
+    // its contribution to 'tree', in O(log n).
+    template<typename RNG>
+    int choose_from_tree(const FenwickTree<long> &tree, deg_t theta, RNG &rng, double &logprob) {
+        long below = tree.prefix_sum(theta - 1);
+        long tot = tree.total() - below;
+        Assert(tot > 0);
+
+        logprob -= std::log(tot);
+
+        deg_t d = tree.find(below + std::uniform_int_distribution<long>(0, tot-1)(rng));
+        return ds.sorted_verts[std::uniform_int_distribution<int>(class_begin(d), class_end(d) - 1)(rng)];
+    }
+
+    template<typename RNG>
+    int choose_fast(deg_t theta, const StubWeight &, RNG &rng, double &logprob) {
+        return choose_from_tree(eligible_degree, theta, rng, logprob);
+    }
+
+    template<typename RNG>
+    int choose_fast(deg_t theta, const UniformWeight &, RNG &rng, double &logprob) {
+        return choose_from_tree(eligible_count, theta, rng, logprob);
+    }
+
+    // No fast method for general weights
+    template<typename Weight, typename RNG>
+    int choose_fast(deg_t, const Weight &, RNG &, double &) { return -1; }
+
+    // Append the allowed vertices and their weights to the given lists, O(number of allowed vertices)
+    template<typename Connectivity, typename Weight>
+    void list_allowed(int vertex, deg_t theta, const Connectivity &conn, const Weight &weight,
+                      vector<int> &vertices, vector<typename Weight::weight_type> &weights) const
+    {
+        const WeightContext<Connectivity> context{conn, vertex, theta};
+
+        with_connectable_from(conn, vertex, [&] (const auto &connectable) {
+            // Positions below 'lo' in ds.sorted_verts have degree less than theta
+            const int lo = class_begin(theta);
+
+            if (scan.parallel(ds.n - lo)) {
+                // Visit the positions from the top down in chunks, skipping excluded vertices,
+                // in the same order as the serial loop below.
+                scan.run(ds.n - lo, [&] (long begin, long end, vector<int> &chunk_vertices, vector<typename Weight::weight_type> &chunk_weights) {
+                    for (int j = ds.n-1 - begin; j >= ds.n - end; --j) {
+                        int v = ds.sorted_verts[j];
+                        deg_t d = ds[v];
+                        if (j < class_end(d) && connectable(v)) {
+                            chunk_vertices.push_back(v);
+                            chunk_weights.push_back(candidate_weight(weight, context, v, d));
+                        }
+                    }
+                }, vertices, weights);
+                return;
+            }
+
+            // Visit the non-excluded vertices of degree at least theta, from the highest degree down
+            for (int i=ds.n-1; i >= 0; ) {
+                deg_t d = ds[ds.sorted_verts[i]];
+                if (d < theta)
+                    break;
+                for (int j = std::min(i, class_end(d) - 1); j >= class_begin(d); --j) {
+                    int v = ds.sorted_verts[j];
+                    if (connectable(v)) {
+                        vertices.push_back(v);
+                        weights.push_back(candidate_weight(weight, context, v, d));
+                    }
+                }
+                i = class_begin(d) - 1;
+            }
+        });
+    }
+
+    // Choose from an explicit list of the allowed vertices
+    template<typename Connectivity, typename Weight, typename RNG>
+    int choose_scan(int vertex, deg_t theta, const Connectivity &conn, const Weight &weight, RNG &rng, double &logprob) {
+        auto &weights = allowed.weights(typename Weight::weight_type());
+        allowed.vertices.clear();
+        weights.clear();
+
+        list_allowed(vertex, theta, conn, weight, allowed.vertices, weights);
+
+        return allowed.choose(weights, rng, logprob);
+    }
+
+public:
+
+    explicit SimpleGraphs(DegreeSequence ds_) :
+        ds(std::move(ds_)),
+        work(ds),
+        current(-1),
+        top(ds.n),
+        wd(0), wd_valid(false),
+        blocked(ds.n)
+    {
+        if (! ds.is_graphical())
+            throw std::invalid_argument("The degree sequence is not graphical.");
+
+        vector<long> count(ds.n), degree(ds.n);
+        for (int d=0; d < ds.n; ++d) {
+            count[d] = ds.counts[d].count;
+            degree[d] = long(d) * ds.counts[d].count;
+        }
+        eligible_count = FenwickTree<long>(count);
+        eligible_degree = FenwickTree<long>(degree);
+    }
+
+    const DegreeSequence &degrees() const { return ds; }
+    int size() const { return ds.n; }
+    int degree_sum() const { return ds.dsum; }
+
+    // Split scans of at least 'threshold' candidates across 'pool'. The samples do not change.
+    // The pool must not be used by another sample at the same time.
+    void use_thread_pool(ThreadPool &pool, long threshold = 1 << 16) { scan.set_pool(&pool, threshold); }
+
+    // Choose a vertex that 'vertex' can connect to without breaking graphicality / connectedness,
+    // and subtract the log of the total weight of the allowed vertices from 'logprob'.
+    template<typename Connectivity, typename Weight, typename RNG>
+    int choose(int vertex, const Connectivity &conn, const Weight &weight, RNG &rng, double &logprob) {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        deg_t theta = threshold();
+
+        if (conn.connectable_to_all(vertex)) {
+            int u = choose_fast(theta, weight, rng, logprob);
+            if (u >= 0)
+                return u;
+        }
+
+        return choose_scan(vertex, theta, conn, weight, rng, logprob);
+    }
+
+    // Append the vertices that 'vertex' can connect to, and their weights, to the given lists.
+    template<typename Connectivity, typename Weight>
+    void allowed_set(int vertex, const Connectivity &conn, const Weight &weight,
+                     vector<int> &vertices, vector<typename Weight::weight_type> &weights)
+    {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        list_allowed(vertex, threshold(), conn, weight, vertices, weights);
+    }
+
+    // The smallest number of free stubs of a vertex that 'vertex' may connect to in its next step
+    deg_t step_threshold(int vertex) {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        return threshold();
+    }
+
+    // Connect 'vertex' to 'u'. The choice need not come from choose(), e.g. it may come from a PrefixCache.
+    void connect(int vertex, int u) {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        neighbours.push_back(u);
+
+        block(u);
+        decrement_blocked(u);
+        decrement_blocked(vertex);
+
+        // Update 'work'. If u is in T, it is unchanged.
+        if (top[u]) {
+            top.erase(u);
+        } else {
+            trim_top();
+            if (! top_list.empty()) {
+                int t = top_list.back();
+                top_list.pop_back();
+                top.erase(t);
+                work.increment(t);
+            }
+            work.decrement(u);
+            wd_valid = false;
+        }
+    }
+
+    // Called when 'vertex' has no more stubs left
+    void finish_vertex(int vertex, double &) {
+        if (vertex != current) // the vertex had no stubs left when its turn came
+            return;
+
+        for (const auto &v : neighbours)
+            unblock(v);
+        unblock(vertex);
+
+        neighbours.clear();
+        top_list.clear();
+        top.clear();
+        current = -1;
+    }
+};
+
+
+// Loop-free multigraphs
+class MultiGraphs {
+    DegreeSequenceMulti ds;
+
+    // Not all multigraphs correspond to the same number of leaves on the decision tree.
+    // Therefore, we must correct the sampling weight by the factorial of each edge multiplicity.
+    // All copies of an edge are created while one of its endpoints is the current vertex,
+    // thus it is sufficient to count the multiplicities of the current vertex's edges.
+    vector<int> multiplicity;
+    vector<int> neighbours;
+
+    AllowedList allowed;
+    ParallelScan scan;
+
+public:
+
+    explicit MultiGraphs(DegreeSequenceMulti ds_) :
+        ds(std::move(ds_)),
+        multiplicity(ds.n)
+    {
+        if (! ds.is_multigraphical())
+            throw std::invalid_argument("The degree sequence is not multigraphical.");
+    }
+
+    const DegreeSequenceMulti &degrees() const { return ds; }
+    int size() const { return ds.n; }
+    int degree_sum() const { return ds.dsum; }
+
+    // Split scans of at least 'threshold' candidates across 'pool'. The samples do not change.
+    // The pool must not be used by another sample at the same time.
+    void use_thread_pool(ThreadPool &pool, long threshold = 1 << 16) { scan.set_pool(&pool, threshold); }
+
+    // The smallest number of free stubs of a vertex that 'vertex' may connect to: 1 if it may connect
+    // to any other vertex, otherwise only the vertices of maximum degree are allowed.
+    deg_t step_threshold(int vertex) const {
+        return ds.dsum > 2*ds.dmax || ds[vertex] == ds.dmax ? 1 : ds.dmax;
+    }
+
+    // Append the vertices that 'vertex' can connect to without breaking multigraphicality / connectedness,
+    // and their weights, to the given lists.
+    template<typename Connectivity, typename Weight>
+    void allowed_set(int vertex, const Connectivity &conn, const Weight &weight,
+                     vector<int> &vertices, vector<typename Weight::weight_type> &weights) const
+    {
+        const WeightContext<Connectivity> context{conn, vertex, step_threshold(vertex)};
+
+        with_connectable_from(conn, vertex, [&] (const auto &connectable) {
+            // Scan the vertices in [begin, end)
+            auto scan_range = [&] (int begin, int end, vector<int> &vertices, vector<typename Weight::weight_type> &weights) {
+                if (ds.dsum > 2*ds.dmax || ds[vertex] == ds.dmax) {
+                    // We can connect to any other vertex
+
+                    for (int v=begin; v < end; ++v)
+                        if ( connectable(v) ) {
+                            vertices.push_back(v);
+                            weights.push_back(candidate_weight(weight, context, v, ds[v]));
+                        }
+                } else {
+                    // We can only connect to max degree vertices
+
+                    for (int v=begin; v < end; ++v)
+                        if (ds[v] == ds.dmax)
+                            if ( connectable(v) ) {
+                                vertices.push_back(v);
+                                weights.push_back(candidate_weight(weight, context, v, ds[v]));
+                            }
+                }
+            };
+
+            const int begin = vertex+1;
+            if (scan.parallel(ds.n - begin))
+                scan.run(ds.n - begin, [&] (long b, long e, vector<int> &chunk_vertices, vector<typename Weight::weight_type> &chunk_weights) {
+                    scan_range(begin + b, begin + e, chunk_vertices, chunk_weights);
+                }, vertices, weights);
+            else
+                scan_range(begin, ds.n, vertices, weights);
+        });
+    }
+
+    // Choose a vertex that 'vertex' can connect to without breaking multigraphicality / connectedness,
+    // and subtract the log of the total weight of the allowed vertices from 'logprob'.
+    template<typename Connectivity, typename Weight, typename RNG>
+    int choose(int vertex, const Connectivity &conn, const Weight &weight, RNG &rng, double &logprob) {
+        auto &weights = allowed.weights(typename Weight::weight_type());
+        allowed.vertices.clear();
+        weights.clear();
+
+        allowed_set(vertex, conn, weight, allowed.vertices, weights);
+
+        return allowed.choose(weights, rng, logprob);
+    }
+
+    void connect(int vertex, int u) {
+        ds.connect(u, vertex);
+        if (multiplicity[u]++ == 0)
+            neighbours.push_back(u);
+    }
+
+    // Called when 'vertex' has no more stubs left
+    void finish_vertex(int, double &logprob) {
+        for (const auto &v : neighbours) {
+            if (multiplicity[v] > 1)
+                logprob -= logfact(multiplicity[v]);
+            multiplicity[v] = 0;
+        }
+        neighbours.clear();
+    }
+};
+
+
+/***** The engine *****/
+
+// A single sample under construction. Edges are added one at a time, and the stubs of
+// each vertex are connected up before moving on to the next vertex.
+// The state can be copied, which allows the population sampler to duplicate partial samples.
+template<typename Connectivity, typename Graphs, typename Weight>
+class Construction {
+    Graphs graphs;
+    Connectivity conn_tracker; // Connectivity tracker
+    Weight weight;
+
+    int vertex;     // The current vertex that we are connecting up
+    long edges;     // Number of edges placed so far
+    double logprob;
+    bool complete;
+
+    // Convert the probability of choosing u to that of choosing one of its stubs, before the state changes
+    void correct(int u, std::false_type) { weight.correct(logprob, graphs.degrees()[u]); }
+
+    void correct(int u, std::true_type) {
+        const WeightContext<Connectivity> context{conn_tracker, vertex, graphs.step_threshold(vertex)};
+        weight.correct(logprob, context, u, graphs.degrees()[u]);
+    }
+
+    template<typename Sink>
+    void connect(int u, Sink &sink) {
+        correct(u, is_context_weight<Weight>());
+
+        graphs.connect(vertex, u);
+        conn_tracker.connect(u, vertex);
+        sink.edge(vertex, u);
+        edges++;
+    }
+
+public:
+
+    Construction(Graphs graphs_, const Weight &weight) :
+        graphs(std::move(graphs_)),
+        conn_tracker(graphs.degrees()),
+        weight(weight),
+        vertex(0),
+        edges(0),
+        logprob(0),
+        complete(graphs.size() == 0)
+    {
+        const bool connected = ! std::is_same<Connectivity, Unconstrained>::value;
+
+        // The null graph is considered non-connected.
+        if (connected && graphs.size() == 0)
+            throw std::invalid_argument("The degree sequence is not potentially connected.");
+
+        if (! conn_tracker.is_potentially_connected())
+            throw std::invalid_argument("The degree sequence is not potentially connected.");
+    }
+
+    const Graphs &state() const { return graphs; }
+
+    bool finished() const { return complete; }
+    int current_vertex() const { return vertex; }
+    long edge_count() const { return edges; }
+    double log_probability() const { return logprob; }
+
+    // Add a single edge, or advance to the next vertex if the current one has no stubs left.
+    template<typename RNG, typename Sink>
+    void step(RNG &rng, Sink &sink) {
+        Assert(! complete);
+
+        if (graphs.degrees()[vertex] == 0) { // No more stubs left on current vertex
+            graphs.finish_vertex(vertex, logprob);
+
+            if (vertex == graphs.size() - 1) // All vertices have been processed
+                complete = true;
+            else
+                vertex += 1; // Advance to next vertex
+            return;
+        }
+
+        int u = graphs.choose(vertex, conn_tracker, weight, rng, logprob);
+
+        connect(u, sink);
+    }
+
+    // True if the next step() adds an edge, rather than advancing to the next vertex.
+    bool edge_next() const { return ! complete && graphs.degrees()[vertex] > 0; }
+
+    // Append the vertices that the next edge may connect to, and their weights, to the given lists.
+    // Only valid if edge_next() is true.
+    void allowed_set(vector<int> &vertices, vector<typename Weight::weight_type> &weights) {
+        graphs.allowed_set(vertex, conn_tracker, weight, vertices, weights);
+    }
+
+    // Add the edge to 'u', which was chosen from allowed_set() with probability proportional
+    // to its weight. 'log_total' is the log of the total weight of the allowed set.
+    template<typename Sink>
+    void add_edge(int u, double log_total, Sink &sink) {
+        Assert(edge_next());
+        logprob -= log_total;
+        connect(u, sink);
+    }
+
+    // Connect up all remaining stubs of the current vertex and advance to the next one.
+    template<typename RNG, typename Sink>
+    void complete_vertex(RNG &rng, Sink &sink) {
+        const int v = vertex;
+        while (! complete && vertex == v)
+            step(rng, sink);
+    }
+};
+
+// True if all connected realizations of the degree sequence are trees. These are sampled directly.
+template<typename Connectivity, typename Graphs>
+bool is_tree_case(const Graphs &graphs) {
+    const bool connected = ! std::is_same<Connectivity, Unconstrained>::value;
+    const int n = graphs.size();
+    return connected && n >= 2 && graphs.degree_sum() == 2*(n - 1);
+}
+
+// Sample graphs of the type given by 'Graphs', passing the edges to 'sink' as they are generated.
+// 'control' is polled after each step, see SampleControl.h. The direct tree sampler is not polled.
+template<typename Connectivity, typename Graphs, typename Weight, typename RNG, typename Sink, typename Control>
+void sample_engine(Graphs graphs, const Weight &weight, RNG &rng, Sink &sink, Control &control) {
+    control.start();
+
+    Construction<Connectivity, Graphs, Weight> sample(std::move(graphs), weight);
+
+    // When there are n-1 edges, all connected realizations are trees. Use the direct tree sampler.
+    if (is_tree_case<Connectivity>(sample.state()))
+        return sample_tree(sample.state().degrees().degrees(), rng, sink);
+
+    while (! sample.finished()) {
+        sample.step(rng, sink);
+        control.poll(sample.edge_count(), sample.current_vertex());
+    }
+
+    sink.finish(sample.log_probability());
+}
+
+template<typename Connectivity, typename Graphs, typename Weight, typename RNG, typename Sink>
+void sample_engine(Graphs graphs, const Weight &weight, RNG &rng, Sink &sink) {
+    NoControl control;
+    sample_engine<Connectivity>(std::move(graphs), weight, rng, sink, control);
+}
+
+// Choose the weight policy for 'alpha' once, then run the engine.
+// alpha = 1 and alpha = 0 use integer weights without any calls to std::pow.
+template<typename Connectivity, typename Graphs, typename RNG, typename Sink, typename Control>
+void sample_dispatch(Graphs graphs, double alpha, RNG &rng, Sink &sink, Control &control) {
+    if (alpha == 1)
+        sample_engine<Connectivity>(std::move(graphs), StubWeight(), rng, sink, control);
+    else if (alpha == 0)
+        sample_engine<Connectivity>(std::move(graphs), UniformWeight(), rng, sink, control);
+    else
+        sample_engine<Connectivity>(std::move(graphs), PowerWeight(alpha), rng, sink, control);
+}
+
+template<typename Connectivity, typename Graphs, typename RNG, typename Sink>
+void sample_dispatch(Graphs graphs, double alpha, RNG &rng, Sink &sink) {
+    NoControl control;
+    sample_dispatch<Connectivity>(std::move(graphs), alpha, rng, sink, control);
+}
+
+} // namespace CDS
+
+#endif // CDS_SAMPLER_ENGINE_H
@@ -0,0 +1,146 @@
+#ifndef CDS_SMALL_BITSET_H
+#define CDS_SMALL_BITSET_H
+
+#include <array>
+#include <cstdint>
+
+namespace CDS {
+
+// Bit operations on 64-bit words, used by the fixed-size engines for small graphs.
+
+// Without a popcount instruction, the builtin calls a library function, which is slower than this
+inline int popcount64(std::uint64_t x) {
+#if defined(__POPCNT__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+// The index of the lowest set bit of x, which must not be 0
+inline int lowest_bit64(std::uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int i = 0;
+    for (; ! (x & 1); x >>= 1)
+        i++;
+    return i;
+#endif
+}
+
+// The index of the k-th set bit of x, counting from 0. Halves the word until a byte is left, then steps through its bits.
+inline int select_bit64(std::uint64_t x, int k) {
+    int position = 0;
+    for (int width = 32; width >= 8; width /= 2) {
+        const std::uint64_t low = x & ((std::uint64_t(1) << width) - 1);
+        const int c = popcount64(low);
+        if (k >= c) {
+            k -= c;
+            x >>= width;
+            position += width;
+        } else {
+            x = low;
+        }
+    }
+    for (; k > 0; --k)
+        x &= x - 1;
+    return position + lowest_bit64(x);
+}
+
+
+// A set of the integers 0 .. 64*Words - 1, stored in place.
+template<int Words>
+class SmallBitset {
+    typedef std::uint64_t word_t;
+
+    std::array<word_t, Words> words;
+
+public:
+
+    static const int capacity = 64 * Words;
+
+    // The empty set
+    SmallBitset() { words.fill(0); }
+
+    // The set 0 .. n-1
+    static SmallBitset first(int n) {
+        SmallBitset s;
+        for (int w=0; w < Words; ++w) {
+            const int bits = n - 64*w;
+            s.words[w] = bits >= 64 ? ~word_t(0) : bits > 0 ? (word_t(1) << bits) - 1 : 0;
+        }
+        return s;
+    }
+
+    bool operator [] (int i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+
+    void insert(int i) { words[i >> 6] |= word_t(1) << (i & 63); }
+    void erase(int i) { words[i >> 6] &= ~(word_t(1) << (i & 63)); }
+    void clear() { words.fill(0); }
+
+    bool empty() const {
+        word_t any = 0;
+        for (int w=0; w < Words; ++w)
+            any |= words[w];
+        return any == 0;
+    }
+
+    int count() const {
+        int c = 0;
+        for (int w=0; w < Words; ++w)
+            c += popcount64(words[w]);
+        return c;
+    }
+
+    // The k-th smallest element, counting from 0. There must be more than k elements.
+    int select(int k) const {
+        for (int w=0; w < Words - 1; ++w) {
+            const int c = popcount64(words[w]);
+            if (k < c)
+                return 64*w + select_bit64(words[w], k);
+            k -= c;
+        }
+        return 64*(Words - 1) + select_bit64(words[Words - 1], k);
+    }
+
+    // Call f(i) for each element i, in increasing order
+    template<typename F>
+    void for_each(F f) const {
+        for (int w=0; w < Words; ++w)
+            for (word_t x = words[w]; x; x &= x - 1)
+                f(64*w + lowest_bit64(x));
+    }
+
+    SmallBitset operator ~ () const {
+        SmallBitset s;
+        for (int w=0; w < Words; ++w)
+            s.words[w] = ~words[w];
+        return s;
+    }
+
+    SmallBitset & operator &= (const SmallBitset &other) {
+        for (int w=0; w < Words; ++w)
+            words[w] &= other.words[w];
+        return *this;
+    }
+
+    SmallBitset & operator |= (const SmallBitset &other) {
+        for (int w=0; w < Words; ++w)
+            words[w] |= other.words[w];
+        return *this;
+    }
+
+    SmallBitset operator & (const SmallBitset &other) const { return SmallBitset(*this) &= other; }
+    SmallBitset operator | (const SmallBitset &other) const { return SmallBitset(*this) |= other; }
+
+    bool operator == (const SmallBitset &other) const { return words == other.words; }
+    bool operator != (const SmallBitset &other) const { return words != other.words; }
+};
+
+} // namespace CDS
+
+#endif // CDS_SMALL_BITSET_H
@@ -0,0 +1,576 @@
+#ifndef CDS_SMALL_GRAPHS_H
+#define CDS_SMALL_GRAPHS_H
+
+#include "Common.h"
+#include "DegreeSequence.h"
+#include "EquivClass.h"
+#include "SamplerEngine.h"
+#include "SmallBitset.h"
+
+#include <array>
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+namespace CDS {
+
+// Fixed-size policies for simple graphs with at most 64 * Words vertices.
+//
+// For graphs with a few dozen vertices, setting up a DegreeSequence, the FenwickTrees and the exclusion set of
+// SimpleGraphs, and an EquivClass, costs more than placing the edges. Here all state is held in std::arrays
+// sized at compile time: the degrees, a bitset of the vertices of each degree, and a bitset of the excluded
+// vertices, i.e. the current vertex and its neighbours. Connected components are bitsets too, see SmallComponents.
+// Nothing is allocated while sampling, and copying the state is a memcpy, which also suits PrefixCache and the
+// population sampler.
+//
+// The allowed set of each step is the one of SimpleGraphs: the non-excluded vertices with degree at least
+// theta = min(wd, lowest degree in T). The degree counts needed for the watershed are popcounts, T is found from
+// the degree bitsets, and the watershed is kept while 'work' does not change. A vertex is chosen by picking its
+// degree class from the class weights, then a set bit of the class, using a single random number.
+//
+// The total weight of the allowed set is summed over the vertices from the highest degree down, as the scan of
+// SimpleGraphs does, thus the logprob of each step, and of each sample, is identical to that of the general
+// engine for the same choices, also with floating point weights. The samples are not identical for the same
+// random stream. Context weights (see SamplerEngine.h) differ within a degree class, so for these the allowed vertices
+// are weighted one at a time, and the total agrees with that of SimpleGraphs up to rounding.
+// with_simple_graphs() selects these policies automatically for small sequences.
+
+
+// The watershed degree of a sequence of n degrees, with count[d] vertices of degree d for d <= dmax,
+// as DegreeSequence::watershed(), in O(dmax)
+template<std::size_t N>
+deg_t small_watershed(const std::array<int, N> &count, deg_t dmax, int n) {
+    std::array<int, N> accum; // the number of vertices with degree <= d
+    int total = 0;
+    for (deg_t d=0; d <= dmax; ++d) {
+        total += count[d];
+        accum[d] = total;
+    }
+
+    // The k-th largest degree, found by moving a cursor down as k increases, and the s-th largest, moving up as s decreases
+    deg_t top = dmax, bottom = 0;
+    auto d_top = [&] (int k) {
+        while (top > 0 && accum[top-1] > n - k)
+            --top;
+        return top;
+    };
+    auto d_bottom = [&] (int s) {
+        while (accum[bottom] <= n - s)
+            ++bottom;
+        return bottom;
+    };
+
+    int wd = 0;
+    int lhs = 0, s = n, r = 0;
+    for (int k=1; k <= n; ++k) {
+        const deg_t dk = d_top(k);
+        lhs += dk;
+
+        // Move past all vertices with degree d(s) < k at once
+        while (s >= k && d_bottom(s) < k) {
+            deg_t deg = d_bottom(s);
+            int run = std::min(accum[deg] - (n - s), s - k + 1);
+            r += run*deg;
+            s -= run;
+        }
+
+        if (s < k)
+            break;
+
+        int diff = lhs - (k*(s-1) + r);
+
+        Assert(diff <= 1);
+
+        if (diff == 1)
+            return dk;
+
+        if (diff == 0)
+            wd = k+1;
+    }
+    return wd;
+}
+
+// A uniform random number in [0, total), drawn with a single call for integer and floating point weights
+template<typename RNG>
+deg_t random_below(deg_t total, RNG &rng) { return std::uniform_int_distribution<deg_t>(0, total-1)(rng); }
+
+template<typename RNG>
+double random_below(double total, RNG &rng) { return std::uniform_real_distribution<double>(0, total)(rng); }
+
+// Add the weight 'w' of 'k' vertices to 'total'. Floating point weights are added one at a time, as a scan
+// of the vertices does, so that the total is identical to that of the general engine.
+inline void add_repeated(deg_t &total, deg_t w, int k) { total += w*k; }
+
+inline void add_repeated(double &total, double w, int k) {
+    for (; k > 0; --k)
+        total += w;
+}
+
+
+// A degree sequence of at most 64 * Words vertices, with a bitset of the vertices of each degree
+template<int Words>
+class SmallDegreeSequence {
+public:
+    typedef SmallBitset<Words> bitset;
+    static const int max_vertices = bitset::capacity;
+
+private:
+    int n;
+    int dsum;
+    deg_t dmax;
+    std::array<deg_t, max_vertices> degree;
+    std::array<bitset, max_vertices> by_degree; // by_degree[d]: the vertices of degree d
+
+public:
+
+    explicit SmallDegreeSequence(const DegreeSequence &ds) :
+        n(ds.size()),
+        dsum(0),
+        dmax(0)
+    {
+        if (n > max_vertices)
+            throw std::invalid_argument("SmallDegreeSequence: too many vertices.");
+
+        for (int v=0; v < n; ++v) {
+            degree[v] = ds[v];
+            by_degree[ds[v]].insert(v);
+            dsum += ds[v];
+            dmax = std::max(dmax, ds[v]);
+        }
+    }
+
+    const deg_t & operator [] (int v) const { return degree[v]; }
+
+    int size() const { return n; }
+    int degree_sum() const { return dsum; }
+    deg_t max_degree() const { return dmax; }
+
+    // The vertices of degree d <= max_degree()
+    const bitset &with_degree(deg_t d) const { return by_degree[d]; }
+
+    // Decrement the degree of vertex v, O(1)
+    void decrement(int v) {
+        const deg_t d = degree[v];
+        Assert(d > 0);
+        by_degree[d].erase(v);
+        by_degree[d-1].insert(v);
+        degree[v]--;
+        dsum--;
+        if (d == dmax && by_degree[d].empty())
+            dmax--;
+    }
+
+    // The degree sequence, O(n)
+    vector<deg_t> degrees() const { return vector<deg_t>(degree.begin(), degree.begin() + n); }
+};
+
+
+// Connectivity policy tracking the connected components as bitsets, for at most 64 * Words vertices.
+// Has the same interface and the same decisions as EquivClass. A component is identified by one of its vertices;
+// when two components are joined, the vertices of the smaller one are relabelled. In addition, connectable_mask()
+// gives the vertices that a vertex may connect to as a bitset, which SmallSimpleGraphs uses instead of testing each vertex.
+template<int Words>
+class SmallComponents {
+public:
+    typedef SmallBitset<Words> bitset;
+    static const int max_vertices = bitset::capacity;
+
+private:
+    int n;
+    int n_supernodes; // number of components
+    int n_edges;      // half the number of free stubs
+    bool closed;      // true if a component has no free stubs left before the construction is complete
+
+    bitset components;                                 // the labels of the components
+    std::array<std::uint8_t, max_vertices> label;      // label[v]: the component of vertex v
+    std::array<bitset, max_vertices> members;          // members[c]: the vertices of component c
+    std::array<deg_t, max_vertices> free_stubs;        // free_stubs[c]: the number of free stubs of component c
+
+public:
+
+    template<typename Container>
+    explicit SmallComponents(const Container &ds) :
+        n(ds.size()),
+        n_supernodes(n),
+        n_edges(0),
+        closed(false)
+    {
+        if (n > max_vertices)
+            throw std::invalid_argument("SmallComponents: too many vertices.");
+
+        for (int i=0; i < n; ++i) {
+            deg_t d = ds[i];
+
+            components.insert(i);
+            label[i] = i;
+            members[i].insert(i);
+            free_stubs[i] = d;
+
+            n_edges += d;
+
+            if (d == 0 && n_supernodes != 1)
+                closed = true;
+        }
+        if (n_edges % 2 == 1)
+            throw std::invalid_argument("Connectivity tracker: The degree sum must be even.");
+        n_edges /= 2;
+    }
+
+    void connect(int a, int b) {
+        n_edges--;
+
+        // With a single component, every connection is allowed until the end, as with EquivClass.
+        if (n_supernodes == 1)
+            return;
+
+        int ca = label[a], cb = label[b];
+
+        if (ca != cb) {
+            n_supernodes -= 1;
+
+            if (members[ca].count() > members[cb].count())
+                std::swap(ca, cb);
+
+            members[ca].for_each([&] (int v) { label[v] = cb; });
+            members[cb] |= members[ca];
+            components.erase(ca);
+
+            free_stubs[cb] = free_stubs[ca] + free_stubs[cb] - 2;
+        } else {
+            free_stubs[cb] -= 2;
+        }
+
+        if (free_stubs[cb] == 0 && n_edges > 0)
+            closed = true;
+    }
+
+    int component_count() const { return n_supernodes; }
+    int edge_count() const { return n_edges; }
+
+    // The number of free stubs of u's component, see EquivClass::component_stubs()
+    deg_t component_stubs(int u) const { return n_supernodes == 1 ? 2*n_edges : free_stubs[label[u]]; }
+
+    bool is_potentially_connected() const {
+        return !closed && n_edges >= n_supernodes-1;
+    }
+
+    // Returns true if connecting u to any vertex v will not break potential connectivity
+    bool connectable_to_all(int u) const {
+        return n_supernodes == 1 ||
+               n_edges == 1 ||
+               (free_stubs[label[u]] > 2 && n_edges > n_supernodes - 1);
+    }
+
+    // Returns true if connecting u to v will not break potential connectivity
+    bool connectable(int u, int v) const {
+        const int cu = label[u], cv = label[v];
+        return connectable_to_all(u) ||
+               (cv != cu && (free_stubs[cu] > 1 || free_stubs[cv] > 1));
+    }
+
+    // Connectability test for a fixed vertex u, see EquivClass::connectable_from()
+    class ConnectableFrom {
+        const SmallComponents &sc;
+        int u;
+        bool to_all;
+
+    public:
+        ConnectableFrom(const SmallComponents &sc, int u) : sc(sc), u(u), to_all(sc.connectable_to_all(u)) { }
+
+        bool all() const { return to_all; }
+        bool operator () (int v) const { return to_all || sc.connectable(u, v); }
+    };
+
+    ConnectableFrom connectable_from(int u) const { return ConnectableFrom(*this, u); }
+
+    // The vertices that u may connect to: those of the other components, and if u's component has a single
+    // free stub left, only those of the other components with more than one.
+    bitset connectable_mask(int u) const {
+        if (connectable_to_all(u))
+            return bitset::first(n);
+
+        const int cu = label[u];
+        if (free_stubs[cu] > 1)
+            return ~members[cu] & bitset::first(n);
+
+        bitset mask;
+        components.for_each([&] (int c) {
+            if (c != cu && free_stubs[c] > 1)
+                mask |= members[c];
+        });
+        return mask;
+    }
+};
+
+
+// The vertices that 'vertex' may connect to according to 'conn', as a bitset
+template<int Words>
+SmallBitset<Words> connectable_mask(const Unconstrained &, int, int n) {
+    return SmallBitset<Words>::first(n);
+}
+
+template<int Words>
+SmallBitset<Words> connectable_mask(const SmallComponents<Words> &conn, int vertex, int) {
+    return conn.connectable_mask(vertex);
+}
+
+// Other connectivity policies, e.g. EquivClass, are asked about each vertex
+template<int Words, typename Connectivity>
+SmallBitset<Words> connectable_mask(const Connectivity &conn, int vertex, int n) {
+    SmallBitset<Words> mask;
+    auto connectable = conn.connectable_from(vertex);
+    for (int v=0; v < n; ++v)
+        if (connectable(v))
+            mask.insert(v);
+    return mask;
+}
+
+
+// Graph type policy for simple graphs with at most 64 * Words vertices, see above.
+// Has the same interface as SimpleGraphs.
+template<int Words>
+class SmallSimpleGraphs {
+public:
+    typedef SmallBitset<Words> bitset;
+    static const int max_vertices = bitset::capacity;
+
+private:
+    SmallDegreeSequence<Words> ds;
+    bitset excluded;    // the current vertex and its neighbours
+
+    int current;        // the vertex being processed, -1 if none
+    deg_t wd;           // watershed degree of 'work', see SimpleGraphs
+    bool wd_valid;
+    deg_t top_degree;   // the lowest degree in T as of the last threshold(), or max_vertices if it may have changed since
+
+    void begin_vertex(int vertex) {
+        current = vertex;
+        excluded.clear();
+        excluded.insert(vertex);
+        wd_valid = false;
+        top_degree = max_vertices;
+    }
+
+    // The smallest degree that the current vertex may connect to. Also sets top_degree, and wd if it is not valid.
+    deg_t threshold() {
+        const deg_t du = ds[current];
+        const deg_t dmax = ds.max_degree();
+        const bitset eligible = ~excluded;
+
+        // 'work': the current vertex removed, and its stubs but one connected to the du-1 highest degree
+        // non-excluded vertices, T
+        std::array<int, max_vertices> count;
+        if (! wd_valid) {
+            for (deg_t d=0; d <= dmax; ++d)
+                count[d] = ds.with_degree(d).count();
+            count[du]--;
+            count[0]++;
+        }
+
+        deg_t lowest_top = dmax + 1;
+        int needed = du - 1;
+        for (deg_t d = dmax; needed > 0; --d) {
+            int k = std::min(needed, (ds.with_degree(d) & eligible).count());
+            if (k > 0) {
+                Assert(d > 0);
+                if (! wd_valid) {
+                    count[d] -= k;
+                    count[d-1] += k;
+                }
+                lowest_top = d;
+                needed -= k;
+            }
+        }
+        top_degree = lowest_top;
+
+        if (! wd_valid) {
+            wd = small_watershed(count, dmax, ds.size());
+            wd_valid = true;
+        }
+
+        deg_t theta = std::min(wd, lowest_top);
+
+        // A watershed degree of 0 means that there is no restriction, but vertices without stubs are never allowed.
+        return std::max(theta, 1);
+    }
+
+    // The allowed vertices, for the current vertex
+    template<typename Connectivity>
+    bitset allowed_mask(const Connectivity &conn) const {
+        return ~excluded & connectable_mask<Words>(conn, current, ds.size());
+    }
+
+    // Degree weights: choose the degree class from the class weights, then a vertex of it uniformly, using the same random number
+    template<typename Context, typename Weight, typename RNG>
+    int choose_allowed(const Context &context, const bitset &allowed, const Weight &weight, RNG &rng, double &logprob, std::false_type) {
+        typedef typename Weight::weight_type weight_type;
+
+        // Total weight of each degree class, summed from the highest degree down
+        std::array<weight_type, max_vertices> class_weight;
+        weight_type total = 0;
+        deg_t lowest = ds.max_degree(); // the lowest class with allowed vertices
+        for (deg_t d = ds.max_degree(); d >= context.theta; --d) {
+            const int k = (ds.with_degree(d) & allowed).count();
+            const weight_type w = weight(d);
+            class_weight[d] = w * k;
+            add_repeated(total, w, k);
+            if (class_weight[d] > 0)
+                lowest = d;
+        }
+        Assert(total > 0);
+
+        logprob -= std::log(total);
+
+        auto pick = random_below(total, rng);
+        deg_t d = ds.max_degree();
+        while (d > lowest && pick >= class_weight[d])
+            pick -= class_weight[d--];
+
+        const bitset candidates = ds.with_degree(d) & allowed;
+        const int k = std::min<int>(pick / weight(d), candidates.count() - 1);
+        return candidates.select(k);
+    }
+
+    // Context weights differ within a degree class: choose from the list of the allowed vertices, in the order of allowed_set()
+    template<typename Context, typename Weight, typename RNG>
+    int choose_allowed(const Context &context, const bitset &allowed, const Weight &weight, RNG &rng, double &logprob, std::true_type) {
+        typedef typename Weight::weight_type weight_type;
+
+        std::array<int, max_vertices> vertices;
+        std::array<weight_type, max_vertices> weights;
+        int k = 0;
+        weight_type total = 0;
+        for (deg_t d = ds.max_degree(); d >= context.theta; --d)
+            (ds.with_degree(d) & allowed).for_each([&] (int v) {
+                vertices[k] = v;
+                weights[k] = candidate_weight(weight, context, v, d);
+                total += weights[k++];
+            });
+        Assert(total > 0);
+
+        logprob -= std::log(total);
+
+        auto pick = random_below(total, rng);
+        int j = 0;
+        while (j < k-1 && pick >= weights[j])
+            pick -= weights[j++];
+        return vertices[j];
+    }
+
+public:
+
+    explicit SmallSimpleGraphs(const DegreeSequence &ds_) :
+        ds(ds_),
+        current(-1),
+        wd(0), wd_valid(false),
+        top_degree(max_vertices)
+    {
+        if (! ds_.is_graphical())
+            throw std::invalid_argument("The degree sequence is not graphical.");
+    }
+
+    const SmallDegreeSequence<Words> &degrees() const { return ds; }
+    int size() const { return ds.size(); }
+    int degree_sum() const { return ds.degree_sum(); }
+
+    // Scans of at most 64 * Words vertices are never worth splitting. For compatibility with SimpleGraphs.
+    void use_thread_pool(ThreadPool &, long = 0) { }
+
+    // Choose a vertex that 'vertex' can connect to without breaking graphicality / connectedness,
+    // and subtract the log of the total weight of the allowed vertices from 'logprob'.
+    template<typename Connectivity, typename Weight, typename RNG>
+    int choose(int vertex, const Connectivity &conn, const Weight &weight, RNG &rng, double &logprob) {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        const WeightContext<Connectivity> context{conn, vertex, threshold()};
+        return choose_allowed(context, allowed_mask(conn), weight, rng, logprob, is_context_weight<Weight>());
+    }
+
+    // Append the vertices that 'vertex' can connect to, and their weights, to the given lists,
+    // in the order of the scan of SimpleGraphs: from the highest degree down.
+    template<typename Connectivity, typename Weight>
+    void allowed_set(int vertex, const Connectivity &conn, const Weight &weight,
+                     vector<int> &vertices, vector<typename Weight::weight_type> &weights)
+    {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        const WeightContext<Connectivity> context{conn, vertex, threshold()};
+        const bitset allowed = allowed_mask(conn);
+
+        for (deg_t d = ds.max_degree(); d >= context.theta; --d)
+            (ds.with_degree(d) & allowed).for_each([&] (int v) {
+                vertices.push_back(v);
+                weights.push_back(candidate_weight(weight, context, v, d));
+            });
+    }
+
+    // The smallest number of free stubs of a vertex that 'vertex' may connect to in its next step
+    deg_t step_threshold(int vertex) {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        return threshold();
+    }
+
+    // Connect 'vertex' to 'u'
+    void connect(int vertex, int u) {
+        if (current != vertex)
+            begin_vertex(vertex);
+
+        // Connecting to a member of T leaves 'work' unchanged, as with SimpleGraphs. Within the lowest degree
+        // class of T, the vertices are interchangeable, so any vertex of degree at least top_degree counts as one.
+        if (ds[u] < top_degree)
+            wd_valid = false;
+        top_degree = max_vertices;
+
+        excluded.insert(u);
+        ds.decrement(u);
+        ds.decrement(vertex);
+    }
+
+    // Called when 'vertex' has no more stubs left
+    void finish_vertex(int vertex, double &) {
+        if (vertex == current)
+            current = -1;
+    }
+};
+
+
+// The connectivity policy used with SmallSimpleGraphs<Words> in place of 'Connectivity'
+template<typename Connectivity, int Words>
+struct SmallConnectivity {
+    typedef Connectivity type;
+};
+
+template<int Words>
+struct SmallConnectivity<EquivClass, Words> {
+    typedef SmallComponents<Words> type;
+};
+
+// Passes a policy type to a generic lambda
+template<typename T>
+struct PolicyTag {
+    typedef T type;
+};
+
+// Call fun(graphs, PolicyTag<C>()) with the graph type policy for simple graphs of 'ds' and the connectivity policy C
+// to use with it in place of 'Connectivity': the fixed-size policies for up to 64 and up to 128 vertices,
+// and SimpleGraphs with 'Connectivity' for larger sequences. Returns the result of 'fun'.
+template<typename Connectivity, typename Fun>
+auto with_simple_graphs(DegreeSequence ds, Fun fun) {
+    if (ds.size() <= SmallSimpleGraphs<1>::max_vertices)
+        return fun(SmallSimpleGraphs<1>(ds), PolicyTag<typename SmallConnectivity<Connectivity, 1>::type>());
+    else if (ds.size() <= SmallSimpleGraphs<2>::max_vertices)
+        return fun(SmallSimpleGraphs<2>(ds), PolicyTag<typename SmallConnectivity<Connectivity, 2>::type>());
+    else
+        return fun(SimpleGraphs(std::move(ds)), PolicyTag<Connectivity>());
+}
+
+} // namespace CDS
+
+#endif // CDS_SMALL_GRAPHS_H
@@ -0,0 +1,90 @@
+#ifndef CDS_STOPPING_RULE_H
+#define CDS_STOPPING_RULE_H
+
+#include "WeightStats.h"
+
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+namespace CDS {
+
+// Decides when to stop generating importance weighted samples.
+//
+// Sampling stops as soon as all of the requested accuracy targets are met, or the time budget is used up.
+// The accuracy targets are a minimum effective sample size, and a maximum relative standard error of
+// the weighted mean of each observable. Targets set to zero are not used. If no accuracy target is set,
+// sampling only stops at the time budget. The clock starts when the object is constructed.
+//
+// Samples are recorded with add(), which is not thread-safe: in multithreaded use, samples must be
+// recorded from a single thread, e.g. the one which collects the results.
+class StoppingRule {
+
+    using clock = std::chrono::steady_clock;
+
+    double target_ess;
+    double target_relerr;
+    double time_budget;  // seconds
+    clock::time_point start;
+
+    WeightStats stats;
+    std::vector<WeightedMean> means;
+
+public:
+
+    // The relative error is not trusted below this many samples, as it is estimated from the samples themselves.
+    static const long min_samples = 10;
+
+    // 'observables' is the number of scalar observables that will be passed to add() with each sample.
+    StoppingRule(double target_ess, double target_relerr, double time_budget, int observables = 0) :
+        target_ess(target_ess), target_relerr(target_relerr), time_budget(time_budget),
+        start(clock::now()),
+        means(observables)
+    {
+        if (target_ess < 0 || target_relerr < 0 || time_budget < 0)
+            throw std::invalid_argument("Stopping targets must be non-negative.");
+        if (target_relerr > 0 && observables == 0)
+            throw std::invalid_argument("A relative error target needs at least one observable.");
+    }
+
+    // Record a sample with the given logprob, and the values of the observables on it.
+    void add(double logprob, const std::vector<double> &values = {}) {
+        if (values.size() != means.size())
+            throw std::invalid_argument("Wrong number of observables.");
+        stats.add(logprob);
+        for (std::size_t k=0; k < means.size(); ++k)
+            means[k].add(logprob, values[k]);
+    }
+
+    bool has_accuracy_target() const { return target_ess > 0 || target_relerr > 0; }
+
+    // Are all accuracy targets met?
+    bool accurate() const {
+        if (! has_accuracy_target() || stats.sample_count() == 0)
+            return false;
+        if (target_ess > 0 && stats.ess() < target_ess)
+            return false;
+        if (target_relerr > 0) {
+            if (stats.sample_count() < min_samples)
+                return false;
+            for (const auto &m : means)
+                if (! (m.relative_error() <= target_relerr)) // also false for NaN
+                    return false;
+        }
+        return true;
+    }
+
+    // Seconds since construction
+    double elapsed() const { return std::chrono::duration<double>(clock::now() - start).count(); }
+
+    bool out_of_time() const { return time_budget > 0 && elapsed() >= time_budget; }
+
+    bool done() const { return accurate() || out_of_time(); }
+
+    const WeightStats &weight_stats() const { return stats; }
+    const std::vector<WeightedMean> &observables() const { return means; }
+};
+
+} // namespace CDS
+
+#endif // CDS_STOPPING_RULE_H
@@ -0,0 +1,127 @@
+#ifndef CDS_THREAD_POOL_H
+#define CDS_THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+namespace CDS {
+
+// A fixed set of worker threads for running parallel loops.
+// The workers are kept alive between loops, so that short loops, such as those run
+// once per vertex by the population sampler, do not pay for thread creation.
+class ThreadPool {
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable start_cv, done_cv;
+
+    std::function<void(long)> task;
+    long task_count;
+    std::atomic<long> next;       // next loop index to be processed
+    int active;                   // number of workers still running the current loop
+    unsigned long generation;     // incremented for each loop
+    bool stopping;
+
+    std::exception_ptr error;
+
+    void run_task() {
+        try {
+            for (long i = next++; i < task_count; i = next++)
+                task(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (! error)
+                error = std::current_exception();
+            next = task_count; // stop all workers
+        }
+    }
+
+    void work() {
+        unsigned long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start_cv.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+
+            run_task();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0)
+                done_cv.notify_one();
+        }
+    }
+
+public:
+
+    // 'threads' is the total number of threads, including the calling thread.
+    // 0 uses all available cores.
+    explicit ThreadPool(int threads = 0) :
+        task_count(0), next(0), active(0), generation(0), stopping(false)
+    {
+        if (threads <= 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (int t=1; t < threads; ++t)
+            workers.emplace_back(&ThreadPool::work, this);
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator = (const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto &th : workers)
+            th.join();
+    }
+
+    int size() const { return workers.size() + 1; }
+
+    // Call f(i) for i = 0 .. count-1 and wait for all calls to finish.
+    // If any call throws, the remaining calls are skipped and the first exception is rethrown.
+    template<typename F>
+    void parallel_for(long count, F f) {
+        if (workers.empty() || count <= 1) {
+            for (long i=0; i < count; ++i)
+                f(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = f;
+            task_count = count;
+            next = 0;
+            error = nullptr;
+            active = workers.size();
+            generation++;
+        }
+        start_cv.notify_all();
+
+        run_task();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [&] { return active == 0; });
+        task = nullptr;
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+} // namespace CDS
+
+#endif // CDS_THREAD_POOL_H
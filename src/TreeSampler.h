@@ -0,0 +1,85 @@
+#ifndef CDS_TREE_SAMPLER_H
+#define CDS_TREE_SAMPLER_H
+
+#include "Common.h"
+#include "EdgeSink.h"
+
+#include <vector>
+#include <tuple>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+namespace CDS {
+
+// Sample trees with the given degrees exactly uniformly, O(n)
+// The degrees must be positive, and their sum must be 2(n-1).
+// Then all connected realizations are trees, including all connected multigraph realizations.
+//
+// Trees on n labelled vertices correspond one-to-one to their Prüfer codes, sequences
+// of length n-2 in which vertex v appears d_v - 1 times. A uniformly shuffled code
+// is decoded into a uniformly sampled tree.
+//
+// The number of such trees is (n-2)! / prod_v (d_v - 1)!. The general samplers use a logprob
+// normalized so that each graph is reached through prod_v d_v! equally weighted construction paths.
+// For consistency, the same normalization is used here, giving a constant logprob of
+// -log( (n-2)! / prod_v (d_v - 1)! * prod_v d_v! ) = -log (n-2)! - sum_v log d_v.
+template<typename RNG, typename Sink>
+void sample_tree(const std::vector<deg_t> &degrees, RNG &rng, Sink &sink) {
+    const int n = degrees.size();
+
+    Assert(n >= 2);
+
+    double logprob = -logfact(n-2);
+
+    // Construct the code with the correct multiplicities, then shuffle it.
+    std::vector<int> code;
+    code.reserve(n-2);
+    for (int v=0; v < n; ++v) {
+        Assert(degrees[v] > 0);
+        for (int k=1; k < degrees[v]; ++k)
+            code.push_back(v);
+        logprob -= std::log(degrees[v]);
+    }
+
+    Assert(int(code.size()) == n-2);
+
+    std::shuffle(code.begin(), code.end(), rng);
+
+    // Linear time Prüfer decoding. 'ptr' scans for the smallest unused leaf,
+    // while newly created leaves smaller than 'ptr' are used immediately.
+    std::vector<deg_t> remaining(degrees);
+
+    int ptr = 0;
+    while (remaining[ptr] != 1)
+        ptr++;
+    int leaf = ptr;
+
+    for (const auto &v : code) {
+        sink.edge(std::min(leaf, v), std::max(leaf, v));
+
+        if (--remaining[v] == 1 && v < ptr) {
+            leaf = v;
+        } else {
+            do
+                ptr++;
+            while (remaining[ptr] != 1);
+            leaf = ptr;
+        }
+    }
+    sink.edge(leaf, n-1);
+
+    sink.finish(logprob);
+}
+
+// Sample trees with the given degrees exactly uniformly, O(n)
+template<typename RNG>
+std::tuple<edgelist_t, double> sample_tree(const std::vector<deg_t> &degrees, RNG &rng) {
+    EdgeListSink sink;
+    sample_tree(degrees, rng, sink);
+    return sink.result();
+}
+
+} // namespace CDS
+
+#endif // CDS_TREE_SAMPLER_H
@@ -0,0 +1,91 @@
+#ifndef CDS_VERTEX_ORDER_H
+#define CDS_VERTEX_ORDER_H
+
+#include "Common.h"
+
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+namespace CDS {
+
+// The order in which the samplers process vertices.
+// The samplers always connect up vertices in order of their index. A different processing
+// order is achieved by relabelling the vertices before sampling, then restoring the
+// original labels in the result.
+enum class VertexOrder { Input, DescDegree, AscDegree, Random };
+
+inline VertexOrder parse_vertex_order(const std::string &name) {
+    if (name == "input")
+        return VertexOrder::Input;
+    if (name == "desc-degree")
+        return VertexOrder::DescDegree;
+    if (name == "asc-degree")
+        return VertexOrder::AscDegree;
+    if (name == "random")
+        return VertexOrder::Random;
+    throw std::invalid_argument("Unknown vertex order '" + name + "'.");
+}
+
+// Relabelling of vertices according to a processing order.
+class Relabelling {
+
+    std::vector<int> label; // label[i] is the original label of the vertex processed i-th
+
+public:
+
+    template<typename RNG>
+    Relabelling(const std::vector<deg_t> &degrees, VertexOrder order, RNG &rng) :
+        label(degrees.size())
+    {
+        std::iota(label.begin(), label.end(), 0);
+
+        switch (order) {
+        case VertexOrder::Input:
+            break;
+        case VertexOrder::DescDegree:
+            std::stable_sort(label.begin(), label.end(), [&degrees] (int u, int v) { return degrees[u] > degrees[v]; });
+            break;
+        case VertexOrder::AscDegree:
+            std::stable_sort(label.begin(), label.end(), [&degrees] (int u, int v) { return degrees[u] < degrees[v]; });
+            break;
+        case VertexOrder::Random:
+            std::shuffle(label.begin(), label.end(), rng);
+            break;
+        }
+    }
+
+    // Degrees in processing order, to be passed to the DegreeSequence constructor
+    std::vector<deg_t> apply(const std::vector<deg_t> &degrees) const {
+        std::vector<deg_t> result(degrees.size());
+        for (size_t i=0; i < label.size(); ++i)
+            result[i] = degrees[label[i]];
+        return result;
+    }
+
+    // The original label of the vertex processed i-th
+    int original(int i) const { return label[i]; }
+
+    // Translate a sampled edge list back to the original labels, O(m)
+    void restore(edgelist_t &edges) const {
+        for (auto &e : edges) {
+            e.first  = label[e.first];
+            e.second = label[e.second];
+        }
+    }
+
+    // True if the relabelling is the identity
+    bool is_identity() const {
+        for (size_t i=0; i < label.size(); ++i)
+            if (label[i] != int(i))
+                return false;
+        return true;
+    }
+};
+
+} // namespace CDS
+
+#endif // CDS_VERTEX_ORDER_H
@@ -0,0 +1,90 @@
+#ifndef CDS_WEIGHT_STATS_H
+#define CDS_WEIGHT_STATS_H
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace CDS {
+
+// Streaming statistics of importance weights, computed from the logprob values returned by the samplers.
+// The weight of a sample is w = exp(-logprob). To avoid overflow, all sums are
+// kept relative to the largest log-weight seen so far.
+class WeightStats {
+
+    long count;
+    double shift; // largest log-weight seen so far
+    double s1;    // sum of exp(logw - shift)
+    double s2;    // sum of exp(2*(logw - shift))
+
+public:
+
+    WeightStats() : count(0), shift(-std::numeric_limits<double>::infinity()), s1(0), s2(0) { }
+
+    void add(double logprob) {
+        double logw = -logprob;
+        if (logw > shift) {
+            double r = std::exp(shift - logw);
+            s1 *= r;
+            s2 *= r*r;
+            shift = logw;
+        }
+        double w = std::exp(logw - shift);
+        s1 += w;
+        s2 += w*w;
+        count++;
+    }
+
+    long sample_count() const { return count; }
+
+    // Kish's effective sample size, (sum w)^2 / sum w^2
+    double ess() const { return count == 0 ? 0 : s1*s1 / s2; }
+
+    // log(sum w)
+    double log_weight_sum() const { return shift + std::log(s1); }
+};
+
+// Streaming importance-weighted mean of a scalar observable x, and its standard error.
+// The mean is sum(w x) / sum(w). The standard error is the delta method estimate,
+// sqrt(sum w^2 (x - mean)^2) / sum(w). As in WeightStats, the sums are kept relative to the largest log-weight.
+class WeightedMean {
+
+    double shift;
+    double s1, s1x;        // sum of w and w x
+    double s2, s2x, s2xx;  // sum of w^2, w^2 x, w^2 x^2
+
+public:
+
+    WeightedMean() : shift(-std::numeric_limits<double>::infinity()), s1(0), s1x(0), s2(0), s2x(0), s2xx(0) { }
+
+    void add(double logprob, double x) {
+        double logw = -logprob;
+        if (logw > shift) {
+            double r = std::exp(shift - logw);
+            s1 *= r; s1x *= r;
+            s2 *= r*r; s2x *= r*r; s2xx *= r*r;
+            shift = logw;
+        }
+        double w = std::exp(logw - shift);
+        s1 += w;
+        s1x += w*x;
+        s2 += w*w;
+        s2x += w*w*x;
+        s2xx += w*w*x*x;
+    }
+
+    double mean() const { return s1x / s1; }
+
+    double standard_error() const {
+        double m = mean();
+        double ss = s2xx - 2*m*s2x + m*m*s2;
+        return std::sqrt(std::max(ss, 0.0)) / s1;
+    }
+
+    // Standard error relative to the magnitude of the mean
+    double relative_error() const { return standard_error() / std::abs(mean()); }
+};
+
+} // namespace CDS
+
+#endif // CDS_WEIGHT_STATS_H